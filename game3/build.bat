@@ -13,4 +13,11 @@ set extra_flags=/W3 /diagnostics:color /diagnostics:caret
 cl %compile_flags% %extra_flags% ..\src\game.cpp /Fegame.exe /link %link_flags%
 if %errorlevel% neq 0 exit /b %errorlevel%
 
+rem bakes the font blob the game loads instead of the ttf
+cl %compile_flags% %extra_flags% ..\src\font_bake.cpp /Fefont_bake.exe /link /DEBUG:FULL /SUBSYSTEM:CONSOLE
+if %errorlevel% neq 0 exit /b %errorlevel%
+
 popd
+
+build\font_bake.exe
+if %errorlevel% neq 0 exit /b %errorlevel%
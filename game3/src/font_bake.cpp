@@ -0,0 +1,27 @@
+// bakes build/alagard.font for load_fonts with the game's own font code,
+// so the game doesn't rasterize the ascii glyphs every time it starts.
+// build.bat runs it, run it again after changing the font or its size.
+// the game bakes from the ttf itself if the blob is missing or stale
+//
+// run from the game3 folder so resources/ and build/ are found
+
+#define SOKOL_NO_ENTRY
+#include "game.cpp"
+
+int main() {
+    init(&state.allocator, MAIN_ALLOCATOR_SIZE);
+    init(&state.frame_allocator, FRAME_ALLOCATOR_SIZE);
+
+    state.font = empty_font();
+    bake_font(STR(FONT_PATH));
+
+    write_font_blob(STR(FONT_BLOB_PATH));
+
+    // the atlas to look at, the game used to write this every time it started
+    i64 write_result = stbi_write_png("build/font.png", state.font.bitmap_width, state.font.bitmap_height, 1, state.font.bitmap, state.font.bitmap_width);
+    assert(write_result != 0);
+
+    print(Slice<u8>{(u8 *) FONT_BLOB_PATH, sizeof(FONT_BLOB_PATH) - 1});
+
+    return 0;
+}
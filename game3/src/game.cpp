@@ -40,6 +40,12 @@
 #define MAX_ENTITIES 128
 #define MAX_QUADS 512
 
+// static quads dont change after the level is made so they are baked into
+// an immutable buffer once and drawn with one sg_draw a frame, only the
+// quads from draw() go through state.quads and get uploaded every frame.
+// the level floor goes here instead of being an entity per tile
+#define MAX_STATIC_QUADS 65536
+
 #define PLAYER_SPEED 100.0f
 
 struct Colour {
@@ -85,13 +91,82 @@ struct GlyphRenderInfo {
     glm::vec2 uvs[4];
 };
 
+// glyphs are rasterized the first time text uses them, any codepoint
+// the font has, into an atlas cut into pages that are rows as tall as
+// the font's bounding box. when no page has room the one used longest ago
+// is emptied. sokol can only replace a whole image so the atlas is only
+// uploaded on frames that added glyphs
+#define GLYPH_SLOTS 512 // power of 2
+
+// the .notdef box's slot, the same as game6's NOTDEF_CODEPOINT
+#define NOTDEF_CODEPOINT 0x110000
+
+struct CachedGlyph {
+    bool used;
+    u32 codepoint;
+    i32 page; // -1 for glyphs with nothing to draw like space
+    f32 width;
+    f32 height;
+    f32 advance;
+    glm::vec2 uvs[4];
+};
+
+struct GlyphPage {
+    i32 y;
+    i32 x; // where the next glyph goes
+    u64 last_used; // frame
+};
+
 struct Font {
     i32 bitmap_width;
     i32 bitmap_height;
-    i32 character_count;
     f32 font_height;
     u8 *bitmap;
-    stbtt_bakedchar *characters;
+
+    stbtt_fontinfo info;
+    Slice<u8> bytes;
+    f32 scale;
+
+    CachedGlyph glyphs[GLYPH_SLOTS];
+    i64 glyph_count;
+
+    i32 page_height;
+    i32 page_count;
+    GlyphPage *pages;
+
+    u64 frame;
+    bool dirty; // glyphs added since the last upload
+};
+
+// font_bake.cpp does what load_fonts used to do every time the game
+// started, rasterizing the ascii glyphs and writing build/font.png, and
+// writes the glyph table, the pages, the atlas and the ttf (glyphs made
+// later still need it) into this. load_fonts maps it and falls back to
+// the ttf if it's missing or was baked by another build or at another size
+#define FONT_PATH "resources/fonts/alagard.ttf"
+#define FONT_BLOB_PATH "build/alagard.font"
+#define FONT_BLOB_MAGIC 0x42544E46 // "FNTB"
+#define FONT_BLOB_VERSION 1
+
+struct FontBlobHeader {
+    u32 magic;
+    u32 version;
+    u32 glyph_size;
+    u32 page_size;
+
+    i32 bitmap_width;
+    i32 bitmap_height;
+    f32 font_height;
+    i32 page_height;
+    i32 page_count;
+    i64 glyph_count;
+
+    // from the start of the file
+    i64 glyphs_offset;
+    i64 pages_offset;
+    i64 bitmap_offset;
+    i64 bytes_offset;
+    i64 bytes_len;
 };
 
 enum TextureId {
@@ -168,6 +243,12 @@ struct State {
     sg_bindings bindings;
     sg_pipeline render_pipeline;
     sg_pass_action pass_action;
+
+    // static layer, static_quads is only kept until bake_static_layer
+    Slice<Quad> static_quads;
+    i64 static_quad_count;
+    sg_bindings static_bindings;
+    sg_pipeline static_pipeline;
 };
 
 internal void init_sokol();
@@ -181,7 +262,7 @@ internal void draw();
 
 internal Entity *create_entity(Entity entity);
 internal Entity *create_player(i64 grid_x, i64 grid_y);
-internal Entity *create_floor(i64 grid_x, i64 grid_y);
+internal void create_floor(i64 grid_x, i64 grid_y);
 
 internal void generate_level();
 
@@ -194,14 +275,32 @@ internal void draw_text(Slice<char> text, glm::vec2 position, f32 font_size, Col
 internal void draw_quad(glm::vec2 position, glm::vec2 size, f32 rotation, Colour colour, RenderLayer layer, DrawType type);
 internal void draw_quad(glm::vec2 position, glm::vec2 size, f32 rotation, Colour colour, RenderLayer layer, DrawType type, 
                         glm::vec2 top_left_uv, glm::vec2 top_right_uv, glm::vec2 bottom_right_uv, glm::vec2 bottom_left_uv);
+internal void write_quad(Quad *quad, glm::mat4 view_projection, glm::vec2 position, glm::vec2 size, f32 rotation, Colour colour, RenderLayer layer, DrawType type, 
+                         glm::vec2 top_left_uv, glm::vec2 top_right_uv, glm::vec2 bottom_right_uv, glm::vec2 bottom_left_uv);
+internal void static_rectangle(glm::vec2 position, glm::vec2 size, Colour colour, RenderLayer layer);
+internal void bake_static_layer();
 
 internal glm::mat4x4 get_view_matrix(glm::vec2 camera);
 internal glm::mat4x4 get_projection_matrix(f32 aspect_ratio, f32 orthographic_size);
 
 internal void load_levels();
 internal void load_fonts();
+internal Font empty_font();
+internal void bake_font(Slice<char> path);
+internal bool load_font_blob(Slice<char> path);
+internal void write_font_blob(Slice<char> path);
+internal CachedGlyph *get_glyph(u32 codepoint);
+internal u64 glyph_home_slot(u32 codepoint);
+internal CachedGlyph *find_glyph(u32 codepoint);
+internal CachedGlyph *cache_glyph(u32 codepoint);
+internal i32 make_room_for_glyph(i32 width);
+internal i32 oldest_glyph_page();
+internal void evict_glyph_page(i32 page);
+internal void remove_glyph(u64 slot);
+internal u32 decode_utf8(Slice<char> text, i64 *index);
 internal void load_textures();
 internal Slice<u8> read_file(Slice<char> path);
+internal Slice<u8> map_file(Slice<char> path);
 internal void write_file(Slice<char> path, Slice<u8> buffer);
 
 internal Slice<char> texture_file_name(TextureId id);
@@ -234,6 +333,13 @@ sapp_desc sokol_main(i32 argc, char **argv) {
     state.entities = alloc<Entity>(&state.allocator, MAX_ENTITIES);
     state.quads = alloc<Quad>(&state.allocator, MAX_QUADS);
 
+    // freed once its baked in init_sokol
+    state.static_quads = Slice<Quad>{
+        .data = (Quad *) malloc(sizeof(Quad) * MAX_STATIC_QUADS),
+        .len = MAX_STATIC_QUADS,
+    };
+    assert(state.static_quads.data);
+
     srand(120);
 
     load_levels();
@@ -294,15 +400,15 @@ void init_sokol() {
         .label = "quad-indices"
     });
 
-    sg_image_desc image_description = {
+    // dynamic images can't be made with data, the glyphs load_fonts added
+    // go up with the first frame since font.dirty is set
+    state.bindings.images[IMG_font_texture] = sg_make_image({
         .width = state.font.bitmap_width,
         .height = state.font.bitmap_height,
+        .usage = SG_USAGE_DYNAMIC,
         .pixel_format = SG_PIXELFORMAT_R8,
         .label = "font_texture", 
-    };
-    image_description.data.subimage[0][0] = {.ptr = state.font.bitmap, .size = (u32)(state.font.bitmap_width * state.font.bitmap_height)};
-
-    state.bindings.images[IMG_font_texture] = sg_make_image(image_description);
+    });
 
     state.bindings.samplers[SMP_default_sampler] = sg_make_sampler({
         .label = "default_sampler"
@@ -340,6 +446,17 @@ void init_sokol() {
 
     state.render_pipeline = sg_make_pipeline(pipeline_desc);
 
+    // the static layer can be a lot bigger than u16 indices go
+    pipeline_desc.index_type = SG_INDEXTYPE_UINT32;
+    pipeline_desc.label = "static-pipeline";
+
+    state.static_pipeline = sg_make_pipeline(pipeline_desc);
+
+    state.static_bindings.images[IMG_font_texture] = state.bindings.images[IMG_font_texture];
+    state.static_bindings.samplers[SMP_default_sampler] = state.bindings.samplers[SMP_default_sampler];
+
+    bake_static_layer();
+
     state.pass_action = {
         .colors = {
             {.load_action = SG_LOADACTION_CLEAR, .clear_value = { 0.6f, 0.75f, 0.8f, 1.0f }}
@@ -349,28 +466,58 @@ void init_sokol() {
 
 internal
 void frame() {
+    reset(&state.frame_allocator);
+    state.font.frame += 1;
+
     update();
     physics(1.0f / 60.0f);
     draw();
 
-    if (state.quad_count == 0) return;
+    if (state.font.dirty) {
+        sg_image_data data = {};
+        data.subimage[0][0] = {.ptr = state.font.bitmap, .size = (u64) (state.font.bitmap_width * state.font.bitmap_height)};
 
-    sg_update_buffer(
-        state.bindings.vertex_buffers[0],
-        { .ptr = state.quads.data, .size = sizeof(Quad) * state.quad_count }
-    );
+        sg_update_image(state.bindings.images[IMG_font_texture], data);
+        state.font.dirty = false;
+    }
+
+    if (state.quad_count == 0 && state.static_quad_count == 0) return;
+
+    if (state.quad_count > 0) {
+        sg_update_buffer(
+            state.bindings.vertex_buffers[0],
+            { .ptr = state.quads.data, .size = sizeof(Quad) * state.quad_count }
+        );
+    }
 
     sg_begin_pass({
         .action = state.pass_action,
         .swapchain = sglue_swapchain()
     });
 
+    if (state.static_quad_count > 0) {
+        glm::mat4 view_matrix = get_view_matrix(state.camera);
+        glm::mat4 projection_matrix = get_projection_matrix((f32)state.width / (f32)state.height, state.camera_view_width * 0.5f);
 
-    sg_apply_pipeline(state.render_pipeline);
-    sg_apply_bindings(state.bindings);
+        vs_params_t params = {.view_projection = projection_matrix * view_matrix};
 
-    sg_draw(0, (i32) state.quad_count * 6, 1);
-    
+        sg_apply_pipeline(state.static_pipeline);
+        sg_apply_bindings(state.static_bindings);
+        sg_apply_uniforms(UB_vs_params, SG_RANGE(params));
+
+        sg_draw(0, (i32) state.static_quad_count * 6, 1);
+    }
+
+    if (state.quad_count > 0) {
+        // already in clip space
+        vs_params_t params = {.view_projection = glm::mat4(1.0f)};
+
+        sg_apply_pipeline(state.render_pipeline);
+        sg_apply_bindings(state.bindings);
+        sg_apply_uniforms(UB_vs_params, SG_RANGE(params));
+
+        sg_draw(0, (i32) state.quad_count * 6, 1);
+    }
 
     sg_end_pass();
 
@@ -495,19 +642,18 @@ Entity *create_player(i64 grid_x, i64 grid_y) {
     });
 }
 
+// floor tiles never move so they go in the static layer, not entities
 internal 
-Entity *create_floor(i64 grid_x, i64 grid_y) {
+void create_floor(i64 grid_x, i64 grid_y) {
     i32 n = rand();
     f32 f = (f32) n / (f32) RAND_MAX;
 
-    return create_entity({
-        .flags = EF_NONE,
-        .position = {(f32) grid_x * GRID_STEP_SIZE, (f32) grid_y * GRID_STEP_SIZE},
-        .size = {GRID_STEP_SIZE, GRID_STEP_SIZE},
-        .colour = {f, f, f, 1.0f},
-        .layer = RL_FLOOR,
-        .grid_position = {grid_x, grid_y},
-    });
+    static_rectangle(
+        {(f32) grid_x * GRID_STEP_SIZE, (f32) grid_y * GRID_STEP_SIZE},
+        {GRID_STEP_SIZE, GRID_STEP_SIZE},
+        {f, f, f, 1.0f},
+        RL_FLOOR
+    );
 }
 
 // does not include line endings just the text from that line
@@ -602,6 +748,58 @@ void generate_level() {
     }
 }
 
+// in world space, the vertex shader does the view projection for these
+internal
+void static_rectangle(glm::vec2 position, glm::vec2 size, Colour colour, RenderLayer layer) {
+    assert(state.static_quads.data); // only before bake_static_layer
+    assert(state.static_quad_count < MAX_STATIC_QUADS);
+
+    Quad *quad = &state.static_quads.data[state.static_quad_count];
+    state.static_quad_count += 1;
+
+    write_quad(quad, glm::mat4(1.0f), position, size, 0, colour, layer, DT_RECTANGLE, {0, 1}, {1, 1}, {1, 0}, {0, 0});
+}
+
+// makes the static layer's vertex and index buffers, both immutable, and
+// frees the quads. sokol has to be set up first
+internal
+void bake_static_layer() {
+    if (state.static_quad_count > 0) {
+        state.static_bindings.vertex_buffers[0] = sg_make_buffer({
+            .data = {.ptr = state.static_quads.data, .size = sizeof(Quad) * state.static_quad_count},
+            .label = "static-quad-vertices"
+        });
+
+        i64 index_count = state.static_quad_count * 6;
+        u32 *index_buffer = (u32 *) malloc(sizeof(u32) * index_count);
+        assert(index_buffer);
+
+        i64 i = 0;
+        while (i < index_count) {
+            // vertex offset pattern to draw a quad
+            // { 0, 1, 2,  0, 2, 3 }
+            index_buffer[i + 0] = (u32) ((i/6)*4 + 0);
+            index_buffer[i + 1] = (u32) ((i/6)*4 + 1);
+            index_buffer[i + 2] = (u32) ((i/6)*4 + 2);
+            index_buffer[i + 3] = (u32) ((i/6)*4 + 0);
+            index_buffer[i + 4] = (u32) ((i/6)*4 + 2);
+            index_buffer[i + 5] = (u32) ((i/6)*4 + 3);
+            i += 6;
+        }
+
+        state.static_bindings.index_buffer = sg_make_buffer({
+            .type = SG_BUFFERTYPE_INDEXBUFFER,
+            .data = {.ptr = index_buffer, .size = sizeof(u32) * (size_t) index_count},
+            .label = "static-quad-indices"
+        });
+
+        free(index_buffer);
+    }
+
+    free(state.static_quads.data);
+    state.static_quads = {};
+}
+
 internal
 void renderer_init() {
     
@@ -645,64 +843,41 @@ void draw_text(Slice<char> text, glm::vec2 position, f32 font_size, Colour colou
 
     if (text.len == 0) return;
 
+    // at most one glyph a byte
     Slice<GlyphRenderInfo> infos = alloc<GlyphRenderInfo>(&state.frame_allocator, text.len);
+    i64 glyph_count = 0;
 
     f32 total_x = 0;
     f32 total_y = 0;
     f32 max_height = 0;
 
-    for (i64 i = 0; i < text.len; i++) {
-        char c = text[i];
-
-        f32 advanced_x = 0;
-        f32 advanced_y = 0;
-
-        stbtt_aligned_quad alligned_quad = {};
-
-
-        // this is the the data for the aligned_quad we're given, with y+ going down
-        //	   x0, y0       x1, y0
-        //     s0, t0       s1, t0
-        //	    o tl        o tr
-        // 
-        //
-        //     x0, y1      x1, y1
-        //     s0, t1      s1, t1
-        //	    o bl        o br
-        // 
-        // x, and y and expected vertex positions
-        // s and t are texture uv position
-        stbtt_GetBakedQuad(state.font.characters, state.font.bitmap_width, state.font.bitmap_height, c - 32, &advanced_x, &advanced_y, &alligned_quad, false);
-
-        f32 width = alligned_quad.x1 - alligned_quad.x0;
-        f32 height = alligned_quad.y1 - alligned_quad.y0;
+    i64 index = 0;
+    while (index < text.len) {
+        CachedGlyph *glyph = get_glyph(decode_utf8(text, &index));
 
-        if (height > max_height) {
-            max_height = height;
+        if (glyph->height > max_height) {
+            max_height = glyph->height;
         }
 
-        glm::vec2 top_left_uv       = {alligned_quad.s0, alligned_quad.t0};
-        glm::vec2 top_right_uv      = { alligned_quad.s1, alligned_quad.t0 };
-        glm::vec2 bottom_right_uv   = {alligned_quad.s1, alligned_quad.t1};
-        glm::vec2 bottom_left_uv    = { alligned_quad.s0, alligned_quad.t1 };
-
-        infos[i] = {
+        infos[glyph_count] = {
             .relative_x = total_x,
             .relative_y = total_y,
-            .width = width,
-            .height = height,
+            .width = glyph->width,
+            .height = glyph->height,
             .uvs = {
-                top_left_uv,
-                top_right_uv,
-                bottom_right_uv,
-                bottom_left_uv
+                glyph->uvs[0],
+                glyph->uvs[1],
+                glyph->uvs[2],
+                glyph->uvs[3]
             }
         };
+        glyph_count += 1;
 
-        total_x += advanced_x;
-        total_y += advanced_y;
+        total_x += glyph->advance;
     }
 
+    infos.len = glyph_count;
+
     f32 scale_factor = (1 / max_height);
     f32 height_scale_factor = scale_factor * font_size; // font size of 1 means tallest glyph is 1 world unit tall
     f32 total_scaled_width = total_x * scale_factor * font_size;
@@ -746,14 +921,20 @@ internal void draw_quad(glm::vec2 position, glm::vec2 size, f32 rotation, Colour
     Quad *quad = &state.quads.data[state.quad_count];
     state.quad_count += 1;
 
+    glm::mat4 view_matrix = get_view_matrix(state.camera);
+    glm::mat4 projection_matrix = get_projection_matrix((f32)state.width / (f32)state.height, state.camera_view_width * 0.5f);
+
+    write_quad(quad, projection_matrix * view_matrix, position, size, rotation, colour, layer, type, top_left_uv, top_right_uv, bottom_right_uv, bottom_left_uv);
+}
+
+// the 4 corners with view_projection applied, the identity leaves them in world space
+internal void write_quad(Quad *quad, glm::mat4 view_projection, glm::vec2 position, glm::vec2 size, f32 rotation, Colour colour, RenderLayer layer, DrawType type, 
+                         glm::vec2 top_left_uv, glm::vec2 top_right_uv, glm::vec2 bottom_right_uv, glm::vec2 bottom_left_uv) {
     glm::mat4 model_matrix = glm::translate(glm::mat4(1.0f), {position.x, position.y, 0});
     model_matrix = glm::rotate(model_matrix, glm::radians(-rotation), glm::vec3{0.0f, 0.0f, 1.0f}); // -rotation so we rotate right
     model_matrix = glm::scale(model_matrix, {size.x, size.y, 1.0f});
 
-    glm::mat4 view_matrix = get_view_matrix(state.camera);
-    glm::mat4 projection_matrix = get_projection_matrix((f32)state.width / (f32)state.height, state.camera_view_width * 0.5f);
-
-    glm::mat4x4 transformation_matrix = projection_matrix * view_matrix * model_matrix;
+    glm::mat4x4 transformation_matrix = view_projection * model_matrix;
 
     glm::vec4 top_left = transformation_matrix * glm::vec4{-0.5, 0.5, 0, 1};
     glm::vec4 top_right = transformation_matrix * glm::vec4{0.5, 0.5, 0, 1};
@@ -835,37 +1016,428 @@ void load_levels() {
 
 internal 
 void load_fonts() {
-    state.font = {
+    state.font = empty_font();
+
+    if (!load_font_blob(STR(FONT_BLOB_PATH))) {
+        bake_font(STR(FONT_PATH));
+    }
+}
+
+// the size the font is baked at, font_bake.cpp uses the same
+internal
+Font empty_font() {
+    return {
         .bitmap_width = 256,
         .bitmap_height = 256,
-        .character_count = 96,
         .font_height = 15.0f,
     };
+}
 
-    state.font.bitmap = (u8 *) malloc(state.font.bitmap_width * state.font.bitmap_height);
+internal
+void bake_font(Slice<char> path) {
+    state.font.bitmap = (u8 *) calloc(state.font.bitmap_width * state.font.bitmap_height, 1);
     assert(state.font.bitmap);
 
-    state.font.characters = (stbtt_bakedchar *) malloc(sizeof(stbtt_bakedchar) * state.font.character_count);
-    assert(state.font.characters);
-
-    Slice<u8> bytes = read_file(STR("resources/fonts/alagard.ttf"));
-
-    i64 bake_result = stbtt_BakeFontBitmap(
-        bytes.data, 
-        0, 
-        state.font.font_height, 
-        state.font.bitmap, 
-        state.font.bitmap_width, 
-        state.font.bitmap_height, 
-        32, 
-        state.font.character_count,
-        state.font.characters
-    );
+    // stbtt_fontinfo points into the bytes so they are kept
+    state.font.bytes = read_file(path);
+
+    i32 init_result = stbtt_InitFont(&state.font.info, state.font.bytes.data, stbtt_GetFontOffsetForIndex(state.font.bytes.data, 0));
+    assert(init_result != 0);
+
+    state.font.scale = stbtt_ScaleForPixelHeight(&state.font.info, state.font.font_height);
+
+    // a pixel between pages so filtering never reads the next one
+    i32 x0, y0, x1, y1;
+    stbtt_GetFontBoundingBox(&state.font.info, &x0, &y0, &x1, &y1);
 
-    assert(bake_result > 0);
+    state.font.page_height = (i32) ceilf((f32) (y1 - y0) * state.font.scale) + 1;
+    state.font.page_count = state.font.bitmap_height / state.font.page_height;
+    assert(state.font.page_count > 0);
 
-    i64 write_result = stbi_write_png("build/font.png", state.font.bitmap_width, state.font.bitmap_height, 1, state.font.bitmap, state.font.bitmap_width);
-    assert(write_result != 0);
+    state.font.pages = (GlyphPage *) calloc(state.font.page_count, sizeof(GlyphPage));
+    assert(state.font.pages);
+
+    for (i32 i = 0; i < state.font.page_count; i++) {
+        state.font.pages[i].y = i * state.font.page_height;
+    }
+
+    // ascii up front, anything else when its first drawn
+    for (u32 codepoint = 32; codepoint < 127; codepoint++) {
+        cache_glyph(codepoint);
+    }
+}
+
+// false if there's no blob or it doesn't match this build and state.font's
+// size, the header is all checked before anything in state.font is set
+internal
+bool load_font_blob(Slice<char> path) {
+    Slice<u8> blob = map_file(path);
+    if (blob.len < (i64) sizeof(FontBlobHeader)) {
+        return false;
+    }
+
+    FontBlobHeader *header = (FontBlobHeader *) blob.data;
+    Font *font = &state.font;
+
+    bool matches = header->magic == FONT_BLOB_MAGIC && header->version == FONT_BLOB_VERSION &&
+        header->glyph_size == sizeof(CachedGlyph) && header->page_size == sizeof(GlyphPage) &&
+        header->bitmap_width == font->bitmap_width && header->bitmap_height == font->bitmap_height &&
+        header->font_height == font->font_height &&
+        header->page_count > 0 && header->glyph_count * 4 <= GLYPH_SLOTS * 3 &&
+        header->glyphs_offset + header->glyph_count * (i64) sizeof(CachedGlyph) <= blob.len &&
+        header->pages_offset + header->page_count * (i64) sizeof(GlyphPage) <= blob.len &&
+        header->bitmap_offset + font->bitmap_width * font->bitmap_height <= blob.len &&
+        header->bytes_offset + header->bytes_len <= blob.len;
+    if (!matches) {
+        return false;
+    }
+
+    font->bytes = Slice<u8>{.data = blob.data + header->bytes_offset, .len = header->bytes_len};
+    if (!stbtt_InitFont(&font->info, font->bytes.data, stbtt_GetFontOffsetForIndex(font->bytes.data, 0))) {
+        return false;
+    }
+
+    font->scale = stbtt_ScaleForPixelHeight(&font->info, font->font_height);
+
+    // glyphs are added to these so they get copies
+    i64 bitmap_size = font->bitmap_width * font->bitmap_height;
+    font->bitmap = (u8 *) malloc(bitmap_size);
+    assert(font->bitmap);
+    memcpy(font->bitmap, blob.data + header->bitmap_offset, bitmap_size);
+
+    font->page_height = header->page_height;
+    font->page_count = header->page_count;
+    font->pages = (GlyphPage *) calloc(font->page_count, sizeof(GlyphPage));
+    assert(font->pages);
+    memcpy(font->pages, blob.data + header->pages_offset, sizeof(GlyphPage) * font->page_count);
+
+    CachedGlyph *glyphs = (CachedGlyph *) (blob.data + header->glyphs_offset);
+    for (i64 i = 0; i < header->glyph_count; i++) {
+        *find_glyph(glyphs[i].codepoint) = glyphs[i];
+    }
+    font->glyph_count = header->glyph_count;
+
+    // the dynamic image starts empty, this gets the atlas up the first frame
+    font->dirty = true;
+
+    return true;
+}
+
+// everything bake_font made, for load_font_blob. font_bake.cpp calls this
+internal
+void write_font_blob(Slice<char> path) {
+    Font *font = &state.font;
+
+    FontBlobHeader header = {
+        .magic = FONT_BLOB_MAGIC,
+        .version = FONT_BLOB_VERSION,
+        .glyph_size = sizeof(CachedGlyph),
+        .page_size = sizeof(GlyphPage),
+        .bitmap_width = font->bitmap_width,
+        .bitmap_height = font->bitmap_height,
+        .font_height = font->font_height,
+        .page_height = font->page_height,
+        .page_count = font->page_count,
+        .glyph_count = font->glyph_count,
+    };
+
+    // each part 16 byte aligned so the structs can be read in place
+    i64 size = ((i64) sizeof(FontBlobHeader) + 15) & ~(i64) 15;
+    header.glyphs_offset = size;
+    size = (size + header.glyph_count * (i64) sizeof(CachedGlyph) + 15) & ~(i64) 15;
+    header.pages_offset = size;
+    size = (size + header.page_count * (i64) sizeof(GlyphPage) + 15) & ~(i64) 15;
+    header.bitmap_offset = size;
+    size = (size + font->bitmap_width * font->bitmap_height + 15) & ~(i64) 15;
+    header.bytes_offset = size;
+    header.bytes_len = font->bytes.len;
+    size += font->bytes.len;
+
+    Slice<u8> blob = Slice<u8>{.data = (u8 *) calloc(size, 1), .len = size};
+    assert(blob.data);
+
+    memcpy(blob.data, &header, sizeof(header));
+
+    CachedGlyph *glyphs = (CachedGlyph *) (blob.data + header.glyphs_offset);
+    i64 glyph_count = 0;
+    for (i64 i = 0; i < GLYPH_SLOTS; i++) {
+        if (font->glyphs[i].used) {
+            glyphs[glyph_count] = font->glyphs[i];
+            glyph_count += 1;
+        }
+    }
+    assert(glyph_count == header.glyph_count);
+
+    memcpy(blob.data + header.pages_offset, font->pages, sizeof(GlyphPage) * font->page_count);
+    memcpy(blob.data + header.bitmap_offset, font->bitmap, font->bitmap_width * font->bitmap_height);
+    memcpy(blob.data + header.bytes_offset, font->bytes.data, font->bytes.len);
+
+    write_file(path, blob);
+    free(blob.data);
+}
+
+internal
+CachedGlyph *get_glyph(u32 codepoint) {
+    CachedGlyph *glyph = find_glyph(codepoint);
+    if (!glyph->used) {
+        glyph = cache_glyph(codepoint);
+    }
+
+    // every page is in use this frame, the space has no page
+    if (!glyph) {
+        glyph = find_glyph(' ');
+    }
+
+    if (glyph->page >= 0) {
+        state.font.pages[glyph->page].last_used = state.font.frame;
+    }
+
+    return glyph;
+}
+
+// where the codepoint's probe starts
+internal
+u64 glyph_home_slot(u32 codepoint) {
+    return ((u64) codepoint * 0x9E3779B97F4A7C15ull) >> 55; // top 9 bits
+}
+
+// the glyph's slot or the empty one it would go in
+internal
+CachedGlyph *find_glyph(u32 codepoint) {
+    u64 start = glyph_home_slot(codepoint);
+
+    for (u64 i = 0; i < GLYPH_SLOTS; i++) {
+        CachedGlyph *glyph = &state.font.glyphs[(start + i) & (GLYPH_SLOTS - 1)];
+
+        if (!glyph->used || glyph->codepoint == codepoint) {
+            return glyph;
+        }
+    }
+
+    // cache_glyph keeps the table at most 3/4 full
+    assert(false);
+    return nullptr;
+}
+
+internal
+CachedGlyph *cache_glyph(u32 codepoint) {
+    Font *font = &state.font;
+
+    i32 index = stbtt_FindGlyphIndex(&font->info, (i32) codepoint);
+    bool missing = index == 0 && codepoint != NOTDEF_CODEPOINT;
+
+    // room for the .notdef too if it has to be made first, so making it
+    // never empties a page and its copy always fits
+    i64 adding = missing && !find_glyph(NOTDEF_CODEPOINT)->used ? 2 : 1;
+
+    while ((font->glyph_count + adding) * 4 > GLYPH_SLOTS * 3) {
+        i32 oldest = oldest_glyph_page();
+        if (oldest < 0) {
+            return nullptr;
+        }
+
+        evict_glyph_page(oldest);
+    }
+
+    if (missing) {
+        CachedGlyph *notdef = find_glyph(NOTDEF_CODEPOINT);
+        if (!notdef->used) {
+            notdef = cache_glyph(NOTDEF_CODEPOINT);
+            if (!notdef) {
+                return nullptr;
+            }
+        }
+
+        CachedGlyph glyph = *notdef;
+        glyph.codepoint = codepoint;
+
+        CachedGlyph *slot = find_glyph(codepoint);
+        *slot = glyph;
+        font->glyph_count += 1;
+
+        return slot;
+    }
+
+    i32 width, height, x_offset, y_offset;
+    u8 *bitmap = stbtt_GetGlyphBitmap(&font->info, font->scale, font->scale, index, &width, &height, &x_offset, &y_offset);
+    if (!bitmap) {
+        width = 0;
+        height = 0;
+    }
+
+    i32 advance, left_side_bearing;
+    stbtt_GetGlyphHMetrics(&font->info, index, &advance, &left_side_bearing);
+
+    CachedGlyph glyph = {
+        .used = true,
+        .codepoint = codepoint,
+        .page = -1,
+        .width = (f32) width,
+        .height = (f32) height,
+        .advance = (f32) advance * font->scale,
+    };
+
+    if (bitmap) {
+        assert(height < font->page_height);
+
+        // a pixel between glyphs so filtering never reads a neighbour
+        i32 index = make_room_for_glyph(width + 1);
+        if (index < 0) {
+            stbtt_FreeBitmap(bitmap, nullptr);
+            return nullptr;
+        }
+
+        GlyphPage *page = &font->pages[index];
+
+        for (i32 row = 0; row < height; row++) {
+            memcpy(font->bitmap + (page->y + row) * font->bitmap_width + page->x, bitmap + row * width, width);
+        }
+
+        f32 left_u   = (f32) page->x / (f32) font->bitmap_width;
+        f32 right_u  = (f32) (page->x + width) / (f32) font->bitmap_width;
+        f32 top_v    = (f32) page->y / (f32) font->bitmap_height;
+        f32 bottom_v = (f32) (page->y + height) / (f32) font->bitmap_height;
+
+        glyph.uvs[0] = {left_u, top_v};
+        glyph.uvs[1] = {right_u, top_v};
+        glyph.uvs[2] = {right_u, bottom_v};
+        glyph.uvs[3] = {left_u, bottom_v};
+
+        page->x += width + 1;
+        page->last_used = font->frame;
+        glyph.page = index;
+
+        font->dirty = true;
+
+        stbtt_FreeBitmap(bitmap, nullptr);
+    }
+
+    CachedGlyph *slot = find_glyph(codepoint);
+    *slot = glyph;
+    font->glyph_count += 1;
+
+    return slot;
+}
+
+// a page with width columns free, emptying the oldest one if none has.
+// -1 when every page is in use this frame
+internal
+i32 make_room_for_glyph(i32 width) {
+    for (i32 i = 0; i < state.font.page_count; i++) {
+        if (state.font.pages[i].x + width <= state.font.bitmap_width) {
+            return i;
+        }
+    }
+
+    i32 oldest = oldest_glyph_page();
+    if (oldest >= 0) {
+        evict_glyph_page(oldest);
+    }
+
+    return oldest;
+}
+
+// least recently used page with glyphs on it, -1 if they were all used this
+// frame. text drawn this frame has their uvs so one can't be emptied yet
+internal
+i32 oldest_glyph_page() {
+    i32 oldest = -1;
+
+    for (i32 i = 0; i < state.font.page_count; i++) {
+        GlyphPage *page = &state.font.pages[i];
+
+        if (page->x > 0 && page->last_used != state.font.frame && (oldest < 0 || page->last_used < state.font.pages[oldest].last_used)) {
+            oldest = i;
+        }
+    }
+
+    return oldest;
+}
+
+internal
+void evict_glyph_page(i32 index) {
+    Font *font = &state.font;
+    font->pages[index].x = 0;
+
+    for (u64 i = 0; i < GLYPH_SLOTS; i++) {
+        // removing shifts the next glyph in the chain into this slot
+        while (font->glyphs[i].used && font->glyphs[i].page == index) {
+            remove_glyph(i);
+        }
+    }
+}
+
+// empties the slot and shifts the glyphs after it in the same run back
+// into the gap, the table is open addressed so a hole would cut their
+// probe chains
+internal
+void remove_glyph(u64 slot) {
+    Font *font = &state.font;
+    u64 mask = GLYPH_SLOTS - 1;
+    u64 gap = slot;
+
+    for (u64 next = (slot + 1) & mask; font->glyphs[next].used; next = (next + 1) & mask) {
+        // it can fill the gap if the gap is between its home and it
+        u64 home = glyph_home_slot(font->glyphs[next].codepoint);
+        if (((next - home) & mask) >= ((next - gap) & mask)) {
+            font->glyphs[gap] = font->glyphs[next];
+            gap = next;
+        }
+    }
+
+    font->glyphs[gap] = {};
+    font->glyph_count -= 1;
+}
+
+// the codepoint at index and moves index past it, anything that isn't
+// valid utf-8 comes out as U+FFFD a byte at a time
+internal
+u32 decode_utf8(Slice<char> text, i64 *index) {
+    u8 first = (u8) text[*index];
+
+    if (first < 0x80) {
+        *index += 1;
+        return first;
+    }
+
+    i64 length = 0;
+    u32 codepoint = 0;
+
+    if ((first & 0xE0) == 0xC0) {
+        length = 2;
+        codepoint = first & 0x1F;
+    } else if ((first & 0xF0) == 0xE0) {
+        length = 3;
+        codepoint = first & 0x0F;
+    } else if ((first & 0xF8) == 0xF0) {
+        length = 4;
+        codepoint = first & 0x07;
+    }
+
+    if (length == 0 || *index + length > text.len) {
+        *index += 1;
+        return 0xFFFD;
+    }
+
+    for (i64 i = 1; i < length; i++) {
+        u8 next = (u8) text[*index + i];
+        if ((next & 0xC0) != 0x80) {
+            *index += 1;
+            return 0xFFFD;
+        }
+
+        codepoint = (codepoint << 6) | (next & 0x3F);
+    }
+
+    // overlong encodings, surrogates and past the last codepoint
+    const u32 smallest[5] = {0, 0, 0x80, 0x800, 0x10000};
+    if (codepoint < smallest[length] || codepoint > 0x10FFFF || (codepoint >= 0xD800 && codepoint <= 0xDFFF)) {
+        *index += 1;
+        return 0xFFFD;
+    }
+
+    *index += length;
+    return codepoint;
 }
 
 internal 
@@ -990,6 +1562,37 @@ Slice<u8> read_file(Slice<char> path) {
     return bytes;
 }
 
+// read only and in place, empty if it can't be opened. never unmapped
+internal 
+Slice<u8> map_file(Slice<char> path) {
+#ifdef WINDOWS
+    HANDLE file = CreateFileA(path.data, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return {};
+    }
+
+    LARGE_INTEGER file_size = {};
+    GetFileSizeEx(file, &file_size);
+
+    HANDLE mapping = file_size.QuadPart > 0 ? CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+    CloseHandle(file);
+    if (mapping == nullptr) {
+        return {};
+    }
+
+    // the view keeps the mapping alive
+    u8 *data = (u8 *) MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (data == nullptr) {
+        return {};
+    }
+
+    return Slice<u8>{.data = data, .len = file_size.QuadPart};
+#else
+#error Need to add a map_file implementation for this platform
+#endif
+}
+
 internal 
 void write_file(Slice<char> path, Slice<u8> buffer) {
     // TODO: using malloc for this and not freeing LUL
@@ -1,4 +1,11 @@
+@ctype mat4 glm::mat4
+
 @vs vs
+// the streamed quads are already in clip space and get the identity, the
+// static layer is in world space. z is the layer either way
+layout(binding=0) uniform vs_params {
+    mat4 view_projection;
+};
 
 in vec3 position;
 in vec4 color0;
@@ -10,7 +17,8 @@ out vec2 texture_uv;
 out float texture_index;
 
 void main() {
-    gl_Position = vec4(position, 1);
+    gl_Position = view_projection * vec4(position.xy, 0, 1);
+    gl_Position.z = position.z;
     color = color0;
     texture_uv = texture_uv0;
     texture_index = texture_index0;
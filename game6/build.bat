@@ -14,4 +14,11 @@ set includes=/I..\src\libs\imgui /I..\src\libs /I..\src\libs\glew\include
 cl %compile_flags% %includes% ..\src\main.cpp %libs% %windows_libs% /Fegame6.exe /link %link_flags%
 if %errorlevel% neq 0 exit /b %errorlevel%
 
+rem bakes the font blobs the game loads instead of the ttf, only needs stb
+cl %compile_flags% /I..\src ..\src\font_bake.cpp /Fefont_bake.exe /link %link_flags%
+if %errorlevel% neq 0 exit /b %errorlevel%
+
 popd
+
+build\font_bake.exe
+if %errorlevel% neq 0 exit /b %errorlevel%
@@ -0,0 +1,27 @@
+@echo off
+
+if not exist build mkdir build
+
+pushd build
+
+set compile_flags=/std:c++20 /O2 /MT /Zi /diagnostics:color /diagnostics:caret
+set link_flags=/DEBUG:FULL /SUBSYSTEM:CONSOLE
+
+cl %compile_flags% ..\src\bench.cpp /Febench.exe /link %link_flags%
+if %errorlevel% neq 0 exit /b %errorlevel%
+
+cl %compile_flags% /arch:AVX2 ..\src\bench.cpp /Febench_avx2.exe /link %link_flags%
+if %errorlevel% neq 0 exit /b %errorlevel%
+
+rem the game itself with the null backend, only needs stb from src\libs
+cl %compile_flags% /I..\src ..\src\headless.cpp /Feheadless.exe /link %link_flags%
+if %errorlevel% neq 0 exit /b %errorlevel%
+
+rem bakes the font blobs the game and headless load instead of the ttf
+cl %compile_flags% /I..\src ..\src\font_bake.cpp /Fefont_bake.exe /link %link_flags%
+if %errorlevel% neq 0 exit /b %errorlevel%
+
+popd
+
+build\font_bake.exe
+if %errorlevel% neq 0 exit /b %errorlevel%
@@ -0,0 +1,13 @@
+set -e
+
+mkdir -p build
+
+g++ -std=c++20 -O2 -g -pthread src/bench.cpp -o build/bench
+g++ -std=c++20 -O2 -g -pthread -mavx2 src/bench.cpp -o build/bench_avx2
+
+# the game itself with the null backend, only needs stb from src/libs
+g++ -std=c++20 -O2 -g -pthread -Isrc src/headless.cpp -o build/headless
+
+# bakes the font blobs the game and headless load instead of the ttf
+g++ -std=c++20 -O2 -g -pthread -Isrc src/font_bake.cpp -o build/font_bake
+./build/font_bake
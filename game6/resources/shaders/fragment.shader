@@ -1,5 +1,9 @@
 #version 460 core
 
+// MATERIAL is defined by the renderer when the program is built, one
+// program per material so nothing here branches, see Material. FONT_SDF
+// is 1 when the font atlas is a distance field, see FontMode
+
 in vec4 colour;
 in vec2 uv;
 flat in int draw_type;
@@ -11,28 +15,33 @@ uniform sampler2D font_texture;
 
 void main()
 {
+#if MATERIAL == 0
     // rectangle
-    if (draw_type == 0) {
-        frag_colour = colour;
-    }
-
+    frag_colour = colour;
+#elif MATERIAL == 1
     // circle
-    if (draw_type == 1) {
-        float d = length(uv - vec2(0.5));
-        if (d > 0.5) {
-            discard;
-        }
-
-        frag_colour = colour;
+    float d = length(uv - vec2(0.5));
+    if (d > 0.5) {
+        discard;
     }
 
+    frag_colour = colour;
+#elif MATERIAL == 2
     // texture
-    if (draw_type == 2) {
-        frag_colour = texture(atlas_texture, uv) * colour;
-    }
-
+    frag_colour = texture(atlas_texture, uv) * colour;
+#elif MATERIAL == 3
     // font
-    if (draw_type == 3) {
-        frag_colour = texture(font_texture, uv).r * colour;
-    }
-} 
+#if FONT_SDF
+    // 0.5 is the edge of the glyph, fwidth is how much the distance
+    // changes over a pixel at the size it is drawn so the edge is always
+    // about a pixel soft
+    float field = texture(font_texture, uv).r;
+    float edge = fwidth(field) * 0.5;
+    float coverage = smoothstep(0.5 - edge, 0.5 + edge, field);
+
+    frag_colour = vec4(colour.rgb, colour.a * coverage);
+#else
+    frag_colour = texture(font_texture, uv).r * colour;
+#endif
+#endif
+}
@@ -0,0 +1,55 @@
+#version 460 core
+
+// one Instance per quad from renderer.cpp, drawn as 6 vertices a quad
+layout (location = 0) in vec2 a_position;
+layout (location = 1) in vec2 a_size;
+layout (location = 2) in float a_rotation;
+layout (location = 3) in vec4 a_colour;
+layout (location = 4) in vec4 a_uv_rect;
+layout (location = 5) in int a_draw_type;
+
+out vec4 colour;
+out vec2 uv;
+flat out int draw_type;
+
+uniform mat4 view_projection;
+
+// top left, top right, bottom right, bottom left as 0 1 2, 0 2 3 like
+// the index buffer on the vertex path
+const int corner_indices[6] = int[](0, 1, 2, 0, 2, 3);
+
+const vec2 corners[4] = vec2[](
+    vec2(-0.5,  0.5),
+    vec2( 0.5,  0.5),
+    vec2( 0.5, -0.5),
+    vec2(-0.5, -0.5)
+);
+
+void main()
+{
+    int corner = corner_indices[gl_VertexID];
+
+    // same as translate * scale * rotate in push_quad, the rotation is
+    // left handed and happens before the scale
+    float angle = radians(a_rotation);
+    float s = sin(angle);
+    float c = cos(angle);
+
+    vec2 local = corners[corner];
+    vec2 rotated = vec2(local.x * c + local.y * s, -local.x * s + local.y * c);
+    vec2 world = a_position + rotated * a_size;
+
+    gl_Position = view_projection * vec4(world, 0.0, 1.0);
+
+    // x, y is the top left uv and z, w the bottom right
+    vec2 uvs[4] = vec2[](
+        a_uv_rect.xy,
+        a_uv_rect.zy,
+        a_uv_rect.zw,
+        a_uv_rect.xw
+    );
+
+    colour = a_colour;
+    uv = uvs[corner];
+    draw_type = a_draw_type;
+}
@@ -0,0 +1,23 @@
+#version 460 core
+
+// PackedVertex from quad.cpp, already in clip space like vertex.shader
+// but x, y are snorm16 scaled down by PACKED_CLIP_RANGE
+layout (location = 0) in vec2 a_position;
+layout (location = 1) in vec4 a_colour;
+layout (location = 2) in vec2 a_uv;
+layout (location = 3) in uint a_draw_type;
+
+out vec4 colour;
+out vec2 uv;
+flat out int draw_type;
+
+const float PACKED_CLIP_RANGE = 4.0;
+
+void main()
+{
+    gl_Position = vec4(a_position * PACKED_CLIP_RANGE, 0.0, 1.0);
+
+    colour = a_colour;
+    uv = a_uv;
+    draw_type = int(a_draw_type);
+}
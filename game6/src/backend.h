@@ -0,0 +1,277 @@
+#ifndef BACKEND_H
+#define BACKEND_H
+
+// every file includes this instead of libs/libs.h directly. normal builds
+// get glfw, glew, imgui and miniaudio from libs, the headless build
+// (HEADLESS defined, see headless.cpp) gets the do nothing versions below
+// so the game can be run and profiled without a window, gl context or
+// sound device. only stb is real in both
+
+#ifndef HEADLESS
+
+#include "libs/libs.h"
+
+#else
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <chrono>
+#include <thread>
+
+#include "libs/stb/stb.h"
+
+// --- gl ---
+
+typedef unsigned int GLenum;
+typedef unsigned int GLuint;
+typedef unsigned int GLbitfield;
+typedef int GLint;
+typedef int GLsizei;
+typedef char GLchar;
+typedef unsigned char GLboolean;
+typedef float GLfloat;
+typedef intptr_t GLintptr;
+typedef intptr_t GLsizeiptr;
+typedef uint64_t GLuint64;
+typedef struct __GLsync *GLsync;
+
+#define GLEW_OK 0
+
+#define GL_FALSE                    0
+#define GL_TRUE                     1
+#define GL_TRIANGLES                0x0004
+#define GL_SRC_ALPHA                0x0302
+#define GL_ONE_MINUS_SRC_ALPHA      0x0303
+#define GL_TEXTURE_2D               0x0DE1
+#define GL_BLEND                    0x0BE2
+#define GL_UNSIGNED_BYTE            0x1401
+#define GL_SHORT                    0x1402
+#define GL_UNSIGNED_SHORT           0x1403
+#define GL_INT                      0x1404
+#define GL_UNSIGNED_INT             0x1405
+#define GL_FLOAT                    0x1406
+#define GL_RED                      0x1903
+#define GL_RGBA                     0x1908
+#define GL_NEAREST                  0x2600
+#define GL_LINEAR                   0x2601
+#define GL_TEXTURE_MAG_FILTER       0x2800
+#define GL_TEXTURE_MIN_FILTER       0x2801
+#define GL_TEXTURE_WRAP_S           0x2802
+#define GL_TEXTURE_WRAP_T           0x2803
+#define GL_REPEAT                   0x2901
+#define GL_UNPACK_ALIGNMENT         0x0CF5
+#define GL_COLOR_BUFFER_BIT         0x4000
+#define GL_TEXTURE0                 0x84C0
+#define GL_TEXTURE1                 0x84C1
+#define GL_ARRAY_BUFFER             0x8892
+#define GL_ELEMENT_ARRAY_BUFFER     0x8893
+#define GL_STATIC_DRAW              0x88E4
+#define GL_DYNAMIC_DRAW             0x88E8
+#define GL_FRAGMENT_SHADER          0x8B30
+#define GL_VERTEX_SHADER            0x8B31
+#define GL_COMPILE_STATUS           0x8B81
+#define GL_LINK_STATUS              0x8B82
+#define GL_MAP_WRITE_BIT            0x0002
+#define GL_MAP_PERSISTENT_BIT       0x0040
+#define GL_MAP_COHERENT_BIT         0x0080
+#define GL_SYNC_FLUSH_COMMANDS_BIT  0x0001
+#define GL_SYNC_GPU_COMMANDS_COMPLETE 0x9117
+#define GL_ALREADY_SIGNALED         0x911A
+#define GL_TIMEOUT_EXPIRED          0x911B
+#define GL_CONDITION_SATISFIED      0x911C
+#define GL_WAIT_FAILED              0x911D
+
+// handed out by every glGen*/glCreate* so nothing ends up as 0
+inline GLuint null_gl_next_id = 1;
+
+inline GLenum glewInit() { return GLEW_OK; }
+
+inline void glEnable(GLenum cap) {}
+inline void glBlendFunc(GLenum source, GLenum destination) {}
+inline void glClearColor(GLfloat r, GLfloat g, GLfloat b, GLfloat a) {}
+inline void glClear(GLbitfield mask) {}
+inline void glViewport(GLint x, GLint y, GLsizei width, GLsizei height) {}
+
+inline GLuint glCreateShader(GLenum type) { return null_gl_next_id++; }
+inline void glShaderSource(GLuint shader, GLsizei count, const GLchar *const *source, const GLint *length) {}
+inline void glCompileShader(GLuint shader) {}
+inline void glGetShaderiv(GLuint shader, GLenum name, GLint *value) { *value = GL_TRUE; }
+inline void glGetShaderInfoLog(GLuint shader, GLsizei size, GLsizei *length, GLchar *log) { log[0] = 0; }
+inline void glDeleteShader(GLuint shader) {}
+inline GLuint glCreateProgram() { return null_gl_next_id++; }
+inline void glAttachShader(GLuint program, GLuint shader) {}
+inline void glLinkProgram(GLuint program) {}
+inline void glGetProgramiv(GLuint program, GLenum name, GLint *value) { *value = GL_TRUE; }
+inline void glGetProgramInfoLog(GLuint program, GLsizei size, GLsizei *length, GLchar *log) { log[0] = 0; }
+inline void glUseProgram(GLuint program) {}
+inline GLint glGetUniformLocation(GLuint program, const GLchar *name) { return 0; }
+inline void glUniform1i(GLint location, GLint value) {}
+inline void glUniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat *value) {}
+inline void glProgramUniformMatrix4fv(GLuint program, GLint location, GLsizei count, GLboolean transpose, const GLfloat *value) {}
+
+inline void glGenVertexArrays(GLsizei count, GLuint *arrays) { for (GLsizei i = 0; i < count; i++) arrays[i] = null_gl_next_id++; }
+inline void glBindVertexArray(GLuint array) {}
+inline void glGenBuffers(GLsizei count, GLuint *buffers) { for (GLsizei i = 0; i < count; i++) buffers[i] = null_gl_next_id++; }
+inline void glBindBuffer(GLenum target, GLuint buffer) {}
+inline void glBufferData(GLenum target, GLsizeiptr size, const void *data, GLenum usage) {}
+inline void glBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void *data) {}
+inline void glBufferStorage(GLenum target, GLsizeiptr size, const void *data, GLbitfield flags) {}
+// the renderer writes straight into mapped buffers so this has to be real
+// memory, they stay mapped for the life of the program so it never frees
+inline void *glMapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access) { return calloc(1, length); }
+inline GLsync glFenceSync(GLenum condition, GLbitfield flags) { return (GLsync) (uintptr_t) null_gl_next_id++; }
+inline GLenum glClientWaitSync(GLsync sync, GLbitfield flags, GLuint64 timeout) { return GL_ALREADY_SIGNALED; }
+inline void glDeleteSync(GLsync sync) {}
+inline void glVertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void *pointer) {}
+inline void glVertexAttribIPointer(GLuint index, GLint size, GLenum type, GLsizei stride, const void *pointer) {}
+inline void glEnableVertexAttribArray(GLuint index) {}
+inline void glVertexAttribDivisor(GLuint index, GLuint divisor) {}
+inline void glDrawElements(GLenum mode, GLsizei count, GLenum type, const void *indices) {}
+inline void glDrawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instance_count) {}
+inline void glDrawElementsBaseVertex(GLenum mode, GLsizei count, GLenum type, const void *indices, GLint base_vertex) {}
+// headless.cpp sets this to see what an instanced draw read, it's called
+// on whichever thread draws
+inline void (*null_gl_on_instanced_draw)(GLsizei instance_count, GLuint base_instance) = nullptr;
+
+inline void glDrawArraysInstancedBaseInstance(GLenum mode, GLint first, GLsizei count, GLsizei instance_count, GLuint base_instance) {
+    if (null_gl_on_instanced_draw) {
+        null_gl_on_instanced_draw(instance_count, base_instance);
+    }
+}
+
+inline void glGenTextures(GLsizei count, GLuint *textures) { for (GLsizei i = 0; i < count; i++) textures[i] = null_gl_next_id++; }
+inline void glBindTexture(GLenum target, GLuint texture) {}
+inline void glActiveTexture(GLenum texture) {}
+inline void glTexParameteri(GLenum target, GLenum name, GLint value) {}
+inline void glTexImage2D(GLenum target, GLint level, GLint internal_format, GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type, const void *data) {}
+inline void glTexSubImage2D(GLenum target, GLint level, GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, const void *data) {}
+inline void glPixelStorei(GLenum name, GLint param) {}
+
+// --- glfw ---
+
+struct GLFWwindow {
+    bool should_close;
+};
+
+#define GLFW_TRUE                   1
+#define GLFW_FALSE                  0
+#define GLFW_RELEASE                0
+#define GLFW_PRESS                  1
+#define GLFW_REPEAT                 2
+#define GLFW_KEY_SPACE              32
+#define GLFW_KEY_A                  65
+#define GLFW_KEY_D                  68
+#define GLFW_KEY_S                  83
+#define GLFW_KEY_W                  87
+#define GLFW_KEY_ESCAPE             256
+#define GLFW_KEY_F1                 290
+#define GLFW_KEY_F2                 291
+#define GLFW_CONTEXT_VERSION_MAJOR  0x00022002
+#define GLFW_CONTEXT_VERSION_MINOR  0x00022003
+#define GLFW_OPENGL_DEBUG_CONTEXT   0x00022007
+#define GLFW_OPENGL_PROFILE         0x00022008
+#define GLFW_OPENGL_CORE_PROFILE    0x00032001
+
+typedef void (*GLFWerrorfun)(int error_code, const char *description);
+typedef void (*GLFWkeyfun)(GLFWwindow *window, int key, int scancode, int action, int mods);
+
+inline GLFWwindow null_glfw_window = {};
+
+inline int glfwInit() { return GLFW_TRUE; }
+inline void glfwTerminate() {}
+inline GLFWwindow *glfwCreateWindow(int width, int height, const char *title, void *monitor, GLFWwindow *share) { return &null_glfw_window; }
+inline void glfwMakeContextCurrent(GLFWwindow *window) {}
+inline GLFWwindow *glfwGetCurrentContext() { return &null_glfw_window; }
+inline GLFWerrorfun glfwSetErrorCallback(GLFWerrorfun callback) { return nullptr; }
+inline GLFWkeyfun glfwSetKeyCallback(GLFWwindow *window, GLFWkeyfun callback) { return nullptr; }
+inline void glfwWindowHint(int hint, int value) {}
+inline void glfwSwapInterval(int interval) {}
+// how long a swap blocks, to stand in for vsync or a gpu bound frame
+inline double null_glfw_swap_time = 0;
+
+inline void glfwSwapBuffers(GLFWwindow *window) {
+    if (null_glfw_swap_time > 0) {
+        std::this_thread::sleep_for(std::chrono::duration<double>(null_glfw_swap_time));
+    }
+}
+inline void glfwPollEvents() {}
+inline int glfwWindowShouldClose(GLFWwindow *window) { return window->should_close; }
+inline void glfwSetWindowShouldClose(GLFWwindow *window, int value) { window->should_close = value; }
+
+inline double glfwGetTime() {
+    timespec time = {};
+    timespec_get(&time, TIME_UTC);
+
+    return (double) time.tv_sec + ((double) time.tv_nsec / 1000000000.0);
+}
+
+// --- imgui ---
+
+#define IMGUI_CHECKVERSION()
+
+enum ImGuiConfigFlags_ {
+    ImGuiConfigFlags_NavEnableKeyboard  = 1 << 0,
+    ImGuiConfigFlags_DockingEnable      = 1 << 6,
+    ImGuiConfigFlags_ViewportsEnable    = 1 << 10,
+};
+
+struct ImGuiIO {
+    int ConfigFlags;
+};
+
+template <typename T>
+struct ImVector {
+    int Size;
+    T *Data;
+
+    T &operator[](int index) { return Data[index]; }
+};
+
+struct ImDrawList {
+    ImDrawList *CloneOutput() const { return nullptr; }
+};
+
+struct ImDrawData {
+    ImVector<ImDrawList *> CmdLists;
+};
+
+#define IM_DELETE(p) delete (p)
+
+namespace ImGui {
+    inline ImGuiIO null_io = {};
+    inline ImDrawData null_draw_data = {};
+
+    inline void *CreateContext() { return nullptr; }
+    inline void StyleColorsDark() {}
+    inline ImGuiIO &GetIO() { return null_io; }
+    inline void NewFrame() {}
+    inline void Render() {}
+    inline ImDrawData *GetDrawData() { return &null_draw_data; }
+    inline void UpdatePlatformWindows() {}
+    inline void RenderPlatformWindowsDefault() {}
+}
+
+inline bool ImGui_ImplGlfw_InitForOpenGL(GLFWwindow *window, bool install_callbacks) { return true; }
+inline void ImGui_ImplGlfw_NewFrame() {}
+inline bool ImGui_ImplOpenGL3_Init(const char *glsl_version) { return true; }
+inline void ImGui_ImplOpenGL3_NewFrame() {}
+inline void ImGui_ImplOpenGL3_RenderDrawData(ImDrawData *draw_data) {}
+
+// --- miniaudio ---
+
+typedef int ma_result;
+
+#define MA_SUCCESS 0
+
+struct ma_engine {};
+struct ma_sound {};
+
+inline ma_result ma_engine_init(const void *config, ma_engine *engine) { return MA_SUCCESS; }
+inline ma_result ma_sound_init_from_file(ma_engine *engine, const char *path, unsigned int flags, void *group, void *fence, ma_sound *sound) { return MA_SUCCESS; }
+inline ma_result ma_sound_start(ma_sound *sound) { return MA_SUCCESS; }
+
+#endif
+
+#endif
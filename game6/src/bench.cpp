@@ -0,0 +1,862 @@
+// standalone benchmarks for the game systems, doesnt need a window, gl
+// or sound so it runs on the build boxes, see build_bench.bat/.sh
+
+#include "hmm.cpp"
+#include "common.cpp"
+#include "collision.cpp"
+#include "entity.cpp"
+#include "quad.cpp"
+
+struct BenchRenderData {
+    i32 texture;
+};
+
+enum BenchFlags {
+    BF_ASTEROID = 1 << 0,
+    BF_MISSLE   = 1 << 1,
+};
+
+// the layout entities had before EntityStore, kept to compare against
+struct BenchEntityAoS {
+    u64 flags;
+    v3 position;
+    v2 size;
+    f32 rotation;
+    v2 velocity;
+    i32 texture;
+};
+
+template <i64 N>
+struct EntityBench {
+    EntityStore<BenchRenderData, N> store;
+    Array<BenchEntityAoS, N> aos;
+    SpatialGrid<N> grid;
+    SpatialGrid<N> missle_grid;
+};
+
+EntityBench<2000> entities_2k = {};
+EntityBench<10000> entities_10k = {};
+EntityBench<100000> entities_100k = {};
+
+#define INTEGRATION_KERNEL_MAX 1000000
+
+JobSystem bench_jobs = {};
+i64 parallel_hits[100000];
+
+alignas(ENTITY_ALIGNMENT) v2 kernel_positions[INTEGRATION_KERNEL_MAX];
+alignas(ENTITY_ALIGNMENT) v2 kernel_velocities[INTEGRATION_KERNEL_MAX];
+
+#define QUAD_TRANSFORM_MAX 100000
+
+struct BenchQuadInput {
+    v3 position;
+    v2 size;
+    f32 rotation;
+};
+
+BenchQuadInput quad_inputs[QUAD_TRANSFORM_MAX];
+Quad matrix_quads[QUAD_TRANSFORM_MAX];
+Quad closed_form_quads[QUAD_TRANSFORM_MAX];
+Quad batched_quads[QUAD_TRANSFORM_MAX];
+PackedQuad packed_quads[QUAD_TRANSFORM_MAX];
+
+template <i64 N> void fill_entities(EntityBench<N> *bench);
+template <i64 N> void bench_collision(EntityBench<N> *bench, i64 frames, i64 brute_force_queries);
+template <i64 N> void bench_collision_layout(EntityBench<N> *bench, i64 frames);
+template <i64 N> void bench_integration(EntityBench<N> *bench, i64 frames);
+template <i64 N> void bench_flag_queries(EntityBench<N> *bench, i64 frames);
+void bench_integration_kernel(i64 count, i64 frames);
+void bench_quad_transform(i64 count, i64 frames);
+void bench_vertex_formats(i64 count, i64 frames);
+void bench_culling(i64 count, f32 spread, i64 frames);
+m4 bench_view_projection();
+void bench_tunnelling(i64 pairs);
+void bench_parallel_queries(i64 frames);
+void count_hits_job(void *data, i64 start, i64 end);
+
+int main() {
+    srand(1234);
+
+    fill_entities(&entities_2k);
+    fill_entities(&entities_10k);
+    fill_entities(&entities_100k);
+
+    printf("collision frame cost (every entity queries every other one)\n");
+    bench_collision(&entities_2k, 100, 2000);
+    bench_collision(&entities_100k, 20, 1000);
+
+    printf("collision narrow phase, array of structs vs EntityStore\n");
+    bench_collision_layout(&entities_10k, 50);
+    bench_collision_layout(&entities_100k, 10);
+
+    printf("asteroid vs missle, every entity + flag test vs flag buckets\n");
+    bench_flag_queries(&entities_2k, 200);
+    bench_flag_queries(&entities_10k, 50);
+    bench_flag_queries(&entities_100k, 10);
+
+    printf("missle vs asteroid hits found, discrete overlap vs swept, against a 2000 hz reference\n");
+    bench_tunnelling(20000);
+
+    printf("collision read phase across the job system, %lld hardware threads\n", (long long) hardware_thread_count());
+    bench_parallel_queries(10);
+
+    printf("integration, array of structs vs EntityStore\n");
+    bench_integration(&entities_10k, 2000);
+    bench_integration(&entities_100k, 200);
+
+#if defined(__AVX__)
+    printf("integration kernel, scalar vs avx\n");
+#elif defined(HANDMADE_MATH__USE_SSE)
+    printf("integration kernel, scalar vs sse\n");
+#else
+    printf("integration kernel, scalar vs scalar (no simd in this build)\n");
+#endif
+    bench_integration_kernel(1000, 100000);
+    bench_integration_kernel(10000, 10000);
+    bench_integration_kernel(1000000, 100);
+
+#if defined(__AVX__)
+    printf("quad corners, HMM_MulM4 chain vs closed form vs batched (avx, 8 quads a register)\n");
+#elif defined(HANDMADE_MATH__USE_SSE)
+    printf("quad corners, HMM_MulM4 chain vs closed form vs batched (sse, 4 quads a register)\n");
+#else
+    printf("quad corners, HMM_MulM4 chain vs closed form vs batched (no simd in this build)\n");
+#endif
+    bench_quad_transform(2000, 1000);
+    bench_quad_transform(100000, 20);
+
+    printf("vertex path quad writes, Vertex (f32) vs PackedVertex\n");
+    bench_vertex_formats(100000, 50);
+
+    printf("vertex path quad writes, everything vs culled to the camera first\n");
+    bench_culling(100000, 1000, 50);
+    bench_culling(100000, 4000, 50);
+
+    return 0;
+}
+
+template <i64 N>
+void fill_entities(EntityBench<N> *bench) {
+    // keep the density about what the game has at 2000 entities, asteroids
+    // and missles half and half spread over the area they live in
+    f32 half_extent = 1000.0f * sqrtf((f32) N / 2000.0f);
+
+    bench->store.len = 0;
+    reset(&bench->aos);
+
+    if (bench->store.bucket_count == 0) {
+        track_flag(&bench->store, (u64) BF_ASTEROID);
+        track_flag(&bench->store, (u64) BF_MISSLE);
+    }
+
+    for (i64 i = 0; i < N; i++) {
+        u64 flags = (i % 2 == 0) ? BF_ASTEROID : BF_MISSLE;
+        f32 size = (i % 2 == 0) ? 60.0f : 10.0f;
+        v2 position = {half_extent * rand_f32_negative(), half_extent * rand_f32_negative()};
+        v2 velocity = vector_from_angle(rand_f32() * 360) * 200.0f;
+
+        add_entity(&bench->store, flags, position, {size, size}, 0, velocity, BenchRenderData{});
+
+        append(&bench->aos, BenchEntityAoS {
+            .position = {position.X, position.Y, 0},
+            .size = {size, size},
+            .velocity = velocity,
+        });
+    }
+}
+
+// brute force is far too slow to run every query at the large counts so
+// it only runs the first brute_force_queries and scales the time up
+template <i64 N>
+void bench_collision(EntityBench<N> *bench, i64 frames, i64 brute_force_queries) {
+    v2 *positions = bench->store.positions;
+    v2 *sizes = bench->store.sizes;
+
+    i64 grid_hits = 0;
+    i64 grid_checked_hits = 0;
+    i64 brute_force_hits = 0;
+
+    f64 grid_start = time_now();
+    for (i64 frame = 0; frame < frames; frame++) {
+        build_spatial_grid(&bench->grid, positions, sizes, bench->store.len);
+
+        for (i64 i = 0; i < bench->store.len; i++) {
+            GridQuery query = new_grid_query(&bench->grid, positions[i], sizes[i]);
+
+            while (true) {
+                i64 other = next_candidate(&bench->grid, &query);
+                if (other < 0) {
+                    break;
+                }
+
+                if (aabb_overlap(positions[i], sizes[i], positions[other], sizes[other])) {
+                    grid_hits++;
+
+                    if (frame == 0 && i < brute_force_queries) {
+                        grid_checked_hits++;
+                    }
+                }
+            }
+        }
+    }
+    f64 grid_time = (time_now() - grid_start) / (f64) frames;
+
+    f64 brute_force_start = time_now();
+    for (i64 i = 0; i < brute_force_queries; i++) {
+        for (i64 other = 0; other < bench->store.len; other++) {
+            if (aabb_overlap(positions[i], sizes[i], positions[other], sizes[other])) {
+                brute_force_hits++;
+            }
+        }
+    }
+    f64 brute_force_time = (time_now() - brute_force_start) * ((f64) N / (f64) brute_force_queries);
+
+    // both have to find exactly the same pairs
+    assert(grid_checked_hits == brute_force_hits);
+
+    printf("  %7lld entities: brute force %9.3f ms/frame, grid %7.3f ms/frame (%.1fx), %lld hits\n",
+        (long long) N, brute_force_time * 1000.0, grid_time * 1000.0, brute_force_time / grid_time, (long long) (grid_hits / frames));
+}
+
+// same grid for both, only changes where the narrow phase reads from
+template <i64 N>
+void bench_collision_layout(EntityBench<N> *bench, i64 frames) {
+    v2 *positions = bench->store.positions;
+    v2 *sizes = bench->store.sizes;
+
+    build_spatial_grid(&bench->grid, positions, sizes, bench->store.len);
+
+    i64 aos_hits = 0;
+    i64 soa_hits = 0;
+
+    f64 aos_start = time_now();
+    for (i64 frame = 0; frame < frames; frame++) {
+        for (i64 i = 0; i < bench->aos.len; i++) {
+            BenchEntityAoS *entity = &bench->aos[i];
+            GridQuery query = new_grid_query(&bench->grid, entity->position.XY, entity->size);
+
+            while (true) {
+                i64 index = next_candidate(&bench->grid, &query);
+                if (index < 0) {
+                    break;
+                }
+
+                BenchEntityAoS *other = &bench->aos[index];
+                if (aabb_overlap(entity->position.XY, entity->size, other->position.XY, other->size)) {
+                    aos_hits++;
+                }
+            }
+        }
+    }
+    f64 aos_time = time_now() - aos_start;
+
+    f64 soa_start = time_now();
+    for (i64 frame = 0; frame < frames; frame++) {
+        for (i64 i = 0; i < bench->store.len; i++) {
+            GridQuery query = new_grid_query(&bench->grid, positions[i], sizes[i]);
+
+            while (true) {
+                i64 other = next_candidate(&bench->grid, &query);
+                if (other < 0) {
+                    break;
+                }
+
+                if (aabb_overlap(positions[i], sizes[i], positions[other], sizes[other])) {
+                    soa_hits++;
+                }
+            }
+        }
+    }
+    f64 soa_time = time_now() - soa_start;
+
+    assert(aos_hits == soa_hits);
+
+    f64 queries = (f64) (N * frames);
+    printf("  %7lld entities: aos %6.2f M queries/s, soa %6.2f M queries/s (%.2fx)\n",
+        (long long) N, queries / aos_time / 1e6, queries / soa_time / 1e6, aos_time / soa_time);
+}
+
+template <i64 N>
+void bench_integration(EntityBench<N> *bench, i64 frames) {
+    const f32 delta_time = 1.0f / 60.0f;
+
+    f64 aos_start = time_now();
+    for (i64 frame = 0; frame < frames; frame++) {
+        for (i64 i = 0; i < bench->aos.len; i++) {
+            BenchEntityAoS *entity = &bench->aos[i];
+
+            entity->position.X += entity->velocity.X * delta_time;
+            entity->position.Y += entity->velocity.Y * delta_time;
+        }
+    }
+    f64 aos_time = time_now() - aos_start;
+
+    v2 *positions = bench->store.positions;
+    v2 *velocities = bench->store.velocities;
+
+    f64 soa_start = time_now();
+    for (i64 frame = 0; frame < frames; frame++) {
+        for (i64 i = 0; i < bench->store.len; i++) {
+            positions[i].X += velocities[i].X * delta_time;
+            positions[i].Y += velocities[i].Y * delta_time;
+        }
+    }
+    f64 soa_time = time_now() - soa_start;
+
+    // both moved the same amount so they should still line up
+    assert(abs(bench->aos[N - 1].position.X - positions[N - 1].X) < 0.01f);
+
+    f64 updates = (f64) (N * frames);
+    printf("  %7lld entities: aos %7.1f M entities/s, soa %7.1f M entities/s (%.2fx)\n",
+        (long long) N, updates / aos_time / 1e6, updates / soa_time / 1e6, aos_time / soa_time);
+}
+
+// the asteroid collision pass from update, before: walk every entity,
+// skip anything not an asteroid and query one grid with everything in it.
+// after: walk the asteroid bucket and query a grid with only missles in
+// it. a pair test is one aabb_overlap call
+template <i64 N>
+void bench_flag_queries(EntityBench<N> *bench, i64 frames) {
+    EntityStore<BenchRenderData, N> *store = &bench->store;
+    v2 *positions = store->positions;
+    v2 *sizes = store->sizes;
+
+    i64 before_tests = 0;
+    i64 before_hits = 0;
+
+    f64 before_start = time_now();
+    for (i64 frame = 0; frame < frames; frame++) {
+        build_spatial_grid(&bench->grid, positions, sizes, store->len);
+
+        for (i64 i = 0; i < store->len; i++) {
+            if (!(store->flags[i] & BF_ASTEROID)) {
+                continue;
+            }
+
+            GridQuery query = new_grid_query(&bench->grid, positions[i], sizes[i]);
+
+            while (true) {
+                i64 other = next_candidate(&bench->grid, &query);
+                if (other < 0) {
+                    break;
+                }
+
+                before_tests++;
+                if (aabb_overlap(positions[i], sizes[i], positions[other], sizes[other]) && (store->flags[other] & BF_MISSLE)) {
+                    before_hits++;
+                }
+            }
+        }
+    }
+    f64 before_time = time_now() - before_start;
+
+    i64 after_tests = 0;
+    i64 after_hits = 0;
+
+    f64 after_start = time_now();
+    for (i64 frame = 0; frame < frames; frame++) {
+        build_spatial_grid(&bench->missle_grid, positions, sizes, entities_with_flag(store, (u64) BF_MISSLE));
+
+        Slice<u32> asteroids = entities_with_flag(store, (u64) BF_ASTEROID);
+
+        for (i64 a = 0; a < asteroids.len; a++) {
+            u32 i = asteroids[a];
+            GridQuery query = new_grid_query(&bench->missle_grid, positions[i], sizes[i]);
+
+            while (true) {
+                i64 other = next_candidate(&bench->missle_grid, &query);
+                if (other < 0) {
+                    break;
+                }
+
+                after_tests++;
+                if (aabb_overlap(positions[i], sizes[i], positions[other], sizes[other])) {
+                    after_hits++;
+                }
+            }
+        }
+    }
+    f64 after_time = time_now() - after_start;
+
+    assert(before_hits == after_hits);
+
+    printf("  %7lld entities: before %9lld pair tests/frame %7.3f ms/frame, after %9lld pair tests/frame %7.3f ms/frame (%.2fx)\n",
+        (long long) N, (long long) (before_tests / frames), before_time * 1000.0 / frames,
+        (long long) (after_tests / frames), after_time * 1000.0 / frames, before_time / after_time);
+}
+
+// one missle fired from the origin at one asteroid flying in, aimed with
+// some error so some of them should miss. each pair is stepped at a few
+// tick rates with both the plain overlap test after every tick and the
+// swept test over every tick, and compared to plain overlap at a tick
+// rate high enough that nothing can skip through
+void bench_tunnelling(i64 pairs) {
+    const i64 rates[] = {2000, 60, 30, 15, 10};
+    const i64 rate_count = sizeof(rates) / sizeof(rates[0]);
+    const f32 duration = 3.0f;
+
+    const v2 missle_size = {10, 10};
+    const v2 asteroid_size = {60, 60};
+
+    i64 discrete_hits[rate_count] = {};
+    i64 swept_hits[rate_count] = {};
+    i64 swept_wrong[rate_count] = {};
+
+    for (i64 pair = 0; pair < pairs; pair++) {
+        v2 direction = vector_from_angle(rand_f32() * 360);
+        v2 asteroid_start = direction * 800.0f;
+        v2 asteroid_velocity = -(direction * 200.0f);
+
+        v2 aim = vector_from_angle(rand_f32() * 360);
+        aim = norm(asteroid_start + (aim * 150.0f));
+        v2 missle_velocity = aim * 400.0f;
+
+        bool reference_hit = false;
+
+        for (i64 r = 0; r < rate_count; r++) {
+            f32 delta_time = 1.0f / (f32) rates[r];
+            i64 ticks = (i64) (duration * rates[r]);
+
+            v2 missle = {};
+            v2 asteroid = asteroid_start;
+
+            bool discrete_hit = false;
+            bool swept_hit = false;
+
+            for (i64 t = 0; t < ticks && !(discrete_hit && swept_hit); t++) {
+                f32 hit_time = 0;
+                if (swept_aabb_overlap(missle, missle_size, missle_velocity * delta_time, asteroid, asteroid_size, asteroid_velocity * delta_time, &hit_time)) {
+                    swept_hit = true;
+                }
+
+                missle = missle + (missle_velocity * delta_time);
+                asteroid = asteroid + (asteroid_velocity * delta_time);
+
+                if (aabb_overlap(missle, missle_size, asteroid, asteroid_size)) {
+                    discrete_hit = true;
+                }
+            }
+
+            if (r == 0) {
+                reference_hit = discrete_hit;
+            }
+
+            discrete_hits[r] += discrete_hit;
+            swept_hits[r] += swept_hit;
+            swept_wrong[r] += swept_hit != reference_hit;
+        }
+    }
+
+    for (i64 r = 1; r < rate_count; r++) {
+        printf("  %4lld hz: reference %lld hits, discrete %lld (%.1f%% missed), swept %lld (%lld disagree)\n",
+            (long long) rates[r], (long long) discrete_hits[0], (long long) discrete_hits[r],
+            100.0 * (f64) (discrete_hits[0] - discrete_hits[r]) / (f64) discrete_hits[0],
+            (long long) swept_hits[r], (long long) swept_wrong[r]);
+    }
+}
+
+// every entity in the 100k bench queries the grid and counts what it
+// hits into its own slot, the read only half of update, at 1 -> 16 threads
+void bench_parallel_queries(i64 frames) {
+    EntityBench<100000> *bench = &entities_100k;
+    build_spatial_grid(&bench->grid, bench->store.positions, bench->store.sizes, bench->store.len);
+
+    const i64 thread_counts[] = {1, 2, 4, 8, 16};
+    f64 single_thread_time = 0;
+    i64 single_thread_hits = 0;
+
+    for (i64 t = 0; t < (i64) (sizeof(thread_counts) / sizeof(thread_counts[0])); t++) {
+        bool ok = init_job_system(&bench_jobs, thread_counts[t]);
+        assert(ok);
+
+        f64 start = time_now();
+        for (i64 frame = 0; frame < frames; frame++) {
+            parallel_for(&bench_jobs, bench->store.len, 256, count_hits_job, bench);
+        }
+        f64 time = (time_now() - start) / (f64) frames;
+
+        shutdown_job_system(&bench_jobs);
+
+        i64 hits = 0;
+        for (i64 i = 0; i < bench->store.len; i++) {
+            hits += parallel_hits[i];
+        }
+
+        if (t == 0) {
+            single_thread_time = time;
+            single_thread_hits = hits;
+        }
+
+        // same work whatever the thread count
+        assert(hits == single_thread_hits);
+
+        // with more threads than the machine has they only take turns, so
+        // the ratio is the job system's overhead and not a speedup
+        if (thread_counts[t] > hardware_thread_count()) {
+            printf("  %2lld threads: %7.3f ms/frame (more threads than cores)\n", (long long) thread_counts[t], time * 1000.0);
+        } else {
+            printf("  %2lld threads: %7.3f ms/frame (%.2fx)\n", (long long) thread_counts[t], time * 1000.0, single_thread_time / time);
+        }
+    }
+}
+
+void count_hits_job(void *data, i64 start, i64 end) {
+    EntityBench<100000> *bench = (EntityBench<100000> *) data;
+    v2 *positions = bench->store.positions;
+    v2 *sizes = bench->store.sizes;
+
+    for (i64 i = start; i < end; i++) {
+        GridQuery query = new_grid_query(&bench->grid, positions[i], sizes[i]);
+        i64 hits = 0;
+
+        while (true) {
+            i64 other = next_candidate(&bench->grid, &query);
+            if (other < 0) {
+                break;
+            }
+
+            if (aabb_overlap(positions[i], sizes[i], positions[other], sizes[other])) {
+                hits++;
+            }
+        }
+
+        parallel_hits[i] = hits;
+    }
+}
+
+void bench_integration_kernel(i64 count, i64 frames) {
+    const f32 delta_time = 1.0f / 60.0f;
+
+    assert(count <= INTEGRATION_KERNEL_MAX);
+
+    for (i64 i = 0; i < count; i++) {
+        kernel_positions[i] = {};
+        kernel_velocities[i] = vector_from_angle(rand_f32() * 360) * 200.0f;
+    }
+
+    f64 scalar_start = time_now();
+    for (i64 frame = 0; frame < frames; frame++) {
+        integrate_positions_scalar(kernel_positions, kernel_velocities, count, delta_time);
+    }
+    f64 scalar_time = time_now() - scalar_start;
+
+    v2 scalar_last = kernel_positions[count - 1];
+
+    for (i64 i = 0; i < count; i++) {
+        kernel_positions[i] = {};
+    }
+
+    f64 simd_start = time_now();
+    for (i64 frame = 0; frame < frames; frame++) {
+        integrate_positions(kernel_positions, kernel_velocities, count, delta_time);
+    }
+    f64 simd_time = time_now() - simd_start;
+
+    // same operations so it should only differ if the compiler fused the
+    // multiply and add in one of them
+    assert(abs(scalar_last.X - kernel_positions[count - 1].X) < 0.01f);
+    assert(abs(scalar_last.Y - kernel_positions[count - 1].Y) < 0.01f);
+
+    f64 updates = (f64) (count * frames);
+    printf("  %7lld entities: scalar %7.1f M entities/s, simd %7.1f M entities/s (%.2fx)\n",
+        (long long) count, updates / scalar_time / 1e6, updates / simd_time / 1e6, scalar_time / simd_time);
+}
+
+// a quarter of the quads have no rotation like rectangles and text do,
+// the camera is the one the game starts with
+void bench_quad_transform(i64 count, i64 frames) {
+    assert(count <= QUAD_TRANSFORM_MAX);
+
+    for (i64 i = 0; i < count; i++) {
+        f32 size = 10.0f + rand_f32() * 50.0f;
+
+        quad_inputs[i] = {
+            .position = {1000.0f * rand_f32_negative(), 1000.0f * rand_f32_negative(), 0},
+            .size = {size, size},
+            .rotation = (i % 4 == 0) ? 0.0f : rand_f32() * 360.0f,
+        };
+    }
+
+    m4 view_projection = bench_view_projection();
+
+    f64 matrix_start = time_now();
+    for (i64 frame = 0; frame < frames; frame++) {
+        for (i64 i = 0; i < count; i++) {
+            BenchQuadInput *input = &quad_inputs[i];
+            transform_quad_matrices(view_projection, input->position, input->size, input->rotation, &matrix_quads[i]);
+        }
+    }
+    f64 matrix_time = time_now() - matrix_start;
+
+    f64 closed_form_start = time_now();
+    for (i64 frame = 0; frame < frames; frame++) {
+        for (i64 i = 0; i < count; i++) {
+            BenchQuadInput *input = &quad_inputs[i];
+            transform_quad(view_projection, input->position, input->size, input->rotation, &closed_form_quads[i]);
+        }
+    }
+    f64 closed_form_time = time_now() - closed_form_start;
+
+    QuadBatch batch = {};
+
+    f64 batched_start = time_now();
+    for (i64 frame = 0; frame < frames; frame++) {
+        for (i64 i = 0; i < count; i++) {
+            BenchQuadInput *input = &quad_inputs[i];
+            if (batch_quad(&batch, input->position, input->size, input->rotation, &batched_quads[i])) {
+                transform_quads(view_projection, &batch);
+            }
+        }
+
+        if (batch.len > 0) {
+            transform_quads(view_projection, &batch);
+        }
+    }
+    f64 batched_time = time_now() - batched_start;
+
+    // bits that differ from the matrix chain, and of those how many only
+    // differ in the sign of a 0
+    i64 closed_form_different = 0;
+    i64 batched_different = 0;
+    i64 signed_zeros = 0;
+
+    for (i64 i = 0; i < count; i++) {
+        for (i64 corner = 0; corner < 4; corner++) {
+            v3 expected = matrix_quads[i].vertices[corner].position;
+            v3 closed_form = closed_form_quads[i].vertices[corner].position;
+            v3 batched = batched_quads[i].vertices[corner].position;
+
+            for (i64 axis = 0; axis < 3; axis++) {
+                f32 a = expected.Elements[axis];
+                f32 b = closed_form.Elements[axis];
+                f32 c = batched.Elements[axis];
+
+                if (memcmp(&a, &b, sizeof(f32)) != 0) {
+                    closed_form_different += 1;
+                    signed_zeros += (a == b) ? 1 : 0;
+                }
+
+                if (memcmp(&a, &c, sizeof(f32)) != 0) {
+                    batched_different += 1;
+                    signed_zeros += (a == c) ? 1 : 0;
+                }
+            }
+        }
+    }
+
+    f64 quads = (f64) (count * frames);
+    printf("  %7lld quads: matrices %6.1f M quads/s, closed form %6.1f M quads/s (%.2fx), batched %6.1f M quads/s (%.2fx)\n",
+        (long long) count, quads / matrix_time / 1e6, quads / closed_form_time / 1e6, matrix_time / closed_form_time,
+        quads / batched_time / 1e6, matrix_time / batched_time);
+    printf("           %lld closed form and %lld batched floats differ from the matrices, %lld of them only as +0/-0\n",
+        (long long) closed_form_different, (long long) batched_different, (long long) signed_zeros);
+}
+
+// writes the same quads push_quad would for each format into ordinary
+// memory, so this is the cpu cost and the bytes that would go to the gpu
+// but not the cost of the writes landing in a mapped buffer. uses the
+// quads bench_quad_transform made
+void bench_vertex_formats(i64 count, i64 frames) {
+    assert(count <= QUAD_TRANSFORM_MAX);
+
+    m4 view_projection = bench_view_projection();
+    v4 colour = {1, 0.5f, 0.25f, 1};
+    v2 uvs[4] = {{0, 1}, {1, 1}, {1, 0}, {0, 0}};
+
+    QuadBatch batch = {};
+
+    f64 floats_start = time_now();
+    for (i64 frame = 0; frame < frames; frame++) {
+        for (i64 i = 0; i < count; i++) {
+            BenchQuadInput *input = &quad_inputs[i];
+            Quad *quad = &batched_quads[i];
+
+            if (batch_quad(&batch, input->position, input->size, input->rotation, quad)) {
+                transform_quads(view_projection, &batch);
+            }
+
+            for (i64 corner = 0; corner < 4; corner++) {
+                quad->vertices[corner].colour = colour;
+                quad->vertices[corner].uv = uvs[corner];
+                quad->vertices[corner].draw_type = 2;
+            }
+        }
+
+        if (batch.len > 0) {
+            transform_quads(view_projection, &batch);
+        }
+    }
+    f64 floats_time = time_now() - floats_start;
+
+    // push_quad packs these into the RenderCommand once, write_quad only
+    // copies them
+    u32 packed_colour = pack_colour(colour);
+    u16 packed_uvs[4][2];
+    for (i64 corner = 0; corner < 4; corner++) {
+        packed_uvs[corner][0] = pack_unorm16(uvs[corner].X);
+        packed_uvs[corner][1] = pack_unorm16(uvs[corner].Y);
+    }
+
+    f64 packed_start = time_now();
+    for (i64 frame = 0; frame < frames; frame++) {
+        for (i64 i = 0; i < count; i++) {
+            BenchQuadInput *input = &quad_inputs[i];
+            PackedQuad *packed = &packed_quads[i];
+
+            if (batch_packed_quad(&batch, input->position, input->size, input->rotation, packed)) {
+                transform_packed_quads(view_projection, &batch);
+            }
+
+            for (i64 corner = 0; corner < 4; corner++) {
+                packed->vertices[corner].colour = packed_colour;
+                packed->vertices[corner].uv[0] = packed_uvs[corner][0];
+                packed->vertices[corner].uv[1] = packed_uvs[corner][1];
+                packed->vertices[corner].draw_type = 2;
+            }
+        }
+
+        if (batch.len > 0) {
+            transform_packed_quads(view_projection, &batch);
+        }
+    }
+    f64 packed_time = time_now() - packed_start;
+
+    // how far the packed corners are from the float ones, in pixels on a
+    // 1440 wide window. only counts corners on screen
+    f32 worst_error = 0;
+    for (i64 i = 0; i < count; i++) {
+        for (i64 corner = 0; corner < 4; corner++) {
+            v3 position = batched_quads[i].vertices[corner].position;
+            PackedVertex *packed = &packed_quads[i].vertices[corner];
+
+            if (abs(position.X) > 1 || abs(position.Y) > 1) {
+                continue;
+            }
+
+            f32 x = max((f32) packed->position[0] / 32767.0f, -1.0f) * PACKED_CLIP_RANGE;
+            f32 y = max((f32) packed->position[1] / 32767.0f, -1.0f) * PACKED_CLIP_RANGE;
+
+            worst_error = max(worst_error, abs(x - position.X) * 720.0f);
+            worst_error = max(worst_error, abs(y - position.Y) * 720.0f);
+        }
+    }
+
+    f64 quads = (f64) (count * frames);
+    printf("  %7lld quads: floats %6.1f M quads/s %6.1f MB/frame, packed %6.1f M quads/s %6.1f MB/frame (%.2fx the float speed), worst on screen error %.3f px\n",
+        (long long) count,
+        quads / floats_time / 1e6, (f64) (sizeof(Quad) * count) / (1024.0 * 1024.0),
+        quads / packed_time / 1e6, (f64) (sizeof(PackedQuad) * count) / (1024.0 * 1024.0),
+        floats_time / packed_time, worst_error);
+}
+
+// quads spread over spread units each way around a camera that sees
+// 800x450 each way like the game's, so the bigger the spread the more of
+// them are off screen. overwrites quad_inputs
+void bench_culling(i64 count, f32 spread, i64 frames) {
+    assert(count <= QUAD_TRANSFORM_MAX);
+
+    for (i64 i = 0; i < count; i++) {
+        f32 size = 10.0f + rand_f32() * 50.0f;
+
+        quad_inputs[i] = {
+            .position = {spread * rand_f32_negative(), spread * rand_f32_negative(), 0},
+            .size = {size, size},
+            .rotation = rand_f32() * 360.0f,
+        };
+    }
+
+    m4 view_projection = bench_view_projection();
+    CullBounds bounds = {
+        .min = {-800, -450},
+        .max = {800, 450},
+    };
+
+    QuadBatch batch = {};
+
+    f64 everything_start = time_now();
+    for (i64 frame = 0; frame < frames; frame++) {
+        for (i64 i = 0; i < count; i++) {
+            BenchQuadInput *input = &quad_inputs[i];
+
+            if (batch_quad(&batch, input->position, input->size, input->rotation, &batched_quads[i])) {
+                transform_quads(view_projection, &batch);
+            }
+        }
+
+        if (batch.len > 0) {
+            transform_quads(view_projection, &batch);
+        }
+    }
+    f64 everything_time = time_now() - everything_start;
+
+    i64 visible = 0;
+
+    f64 culled_start = time_now();
+    for (i64 frame = 0; frame < frames; frame++) {
+        visible = 0;
+
+        for (i64 i = 0; i < count; i++) {
+            BenchQuadInput *input = &quad_inputs[i];
+
+            if (!quad_visible(bounds, input->position, input->size, input->rotation)) {
+                continue;
+            }
+
+            // packed together like push_quad does into a batch
+            if (batch_quad(&batch, input->position, input->size, input->rotation, &closed_form_quads[visible])) {
+                transform_quads(view_projection, &batch);
+            }
+
+            visible += 1;
+        }
+
+        if (batch.len > 0) {
+            transform_quads(view_projection, &batch);
+        }
+    }
+    f64 culled_time = time_now() - culled_start;
+
+    // anything dropped has to be entirely outside the view, clip space -1 to 1
+    i64 wrongly_culled = 0;
+    i64 next_visible = 0;
+    for (i64 i = 0; i < count; i++) {
+        BenchQuadInput *input = &quad_inputs[i];
+
+        if (quad_visible(bounds, input->position, input->size, input->rotation)) {
+            next_visible += 1;
+            continue;
+        }
+
+        Quad *quad = &batched_quads[i];
+        f32 min_x = 1e9f, max_x = -1e9f, min_y = 1e9f, max_y = -1e9f;
+
+        for (i64 corner = 0; corner < 4; corner++) {
+            min_x = min(min_x, quad->vertices[corner].position.X);
+            max_x = max(max_x, quad->vertices[corner].position.X);
+            min_y = min(min_y, quad->vertices[corner].position.Y);
+            max_y = max(max_y, quad->vertices[corner].position.Y);
+        }
+
+        if (max_x >= -1 && min_x <= 1 && max_y >= -1 && min_y <= 1) {
+            wrongly_culled += 1;
+        }
+    }
+    assert(next_visible == visible);
+
+    f64 quads = (f64) (count * frames);
+    printf("  %6lld quads over +-%.0f, %5.1f%% visible: everything %6.2f ms/frame %5.1f ns/quad, culled %6.2f ms/frame %5.1f ns/quad, %.1fx, %lld wrongly culled\n",
+        (long long) count, spread, 100.0 * (f64) visible / (f64) count,
+        everything_time * 1000.0 / (f64) frames, everything_time * 1e9 / quads,
+        culled_time * 1000.0 / (f64) frames, culled_time * 1e9 / quads,
+        everything_time / culled_time, (long long) wrongly_culled);
+}
+
+// the camera the game starts with on a 16:9 window
+m4 bench_view_projection() {
+    f32 aspect = 16.0f / 9.0f;
+    f32 orthographic_size = 450.0f;
+    m4 projection = HMM_Orthographic_LH_NO(-orthographic_size * aspect, orthographic_size * aspect, -orthographic_size, orthographic_size, 0.1f, 100.0f);
+    m4 view = HMM_LookAt_LH({0, 0, -1}, {0, 0, 0}, {0, 1, 0});
+
+    return HMM_MulM4(projection, view);
+}
@@ -0,0 +1,391 @@
+#ifndef COLLISION_CPP
+#define COLLISION_CPP
+
+#include "hmm.cpp"
+#include "common.cpp"
+
+// broadphase for the collision iterator, every entity goes into the cell
+// its centre is in and a query walks every cell its box touches, grown by
+// the biggest half size in the grid so nothing poking over a cell edge is
+// missed. cells are hashed into buckets so the world doesnt need bounds,
+// and the buckets are counting sorted into one flat array when it is
+// rebuilt at the start of every frame
+
+#define GRID_CELL_SIZE 64
+
+// fast entities can move further than they are big in one tick so a
+// plain overlap at the start of the tick misses them, they are checked
+// with swept_aabb_overlap instead over the whole motion of the tick.
+// the broadphase for that is a sort and sweep list, every target gets
+// the interval its box sweeps along one axis during the tick, the list
+// is sorted by where the intervals start and a query binary searches
+// to the first one that could reach it. the axis is whichever one the
+// fast entities move along the most so intervals overlap as little as
+// possible
+
+struct SweepItem {
+    f32 min;
+    f32 max;
+    u32 index;
+};
+
+template <i64 N>
+struct SweepList {
+    i32 axis; // 0 is x, 1 is y
+    f32 max_length;
+    i64 count;
+
+    SweepItem items[N];
+};
+
+struct SweepQuery {
+    f32 min;
+    f32 max;
+    i64 item;
+};
+
+constexpr i64 grid_bucket_count(i64 n) {
+    // at least twice as many buckets as entities and always a power of 2
+    i64 count = 1;
+    while (count < n * 2) {
+        count *= 2;
+    }
+
+    return count;
+}
+
+template <i64 N>
+struct SpatialGrid {
+    static constexpr i64 BUCKET_COUNT = grid_bucket_count(N);
+
+    f32 cell_size;
+    v2 max_half_size;
+    i64 count;
+
+    // bucket b owns items[bucket_starts[b] .. bucket_starts[b + 1]]
+    u32 bucket_starts[BUCKET_COUNT + 1];
+    u32 items[N];
+    u32 item_buckets[N];
+};
+
+struct GridQuery {
+    i32 min_x;
+    i32 min_y;
+    i32 max_x;
+    i32 max_y;
+
+    i32 cell_x;
+    i32 cell_y;
+
+    u32 item;
+    u32 item_end;
+};
+
+template <i64 N> u32 grid_bucket(i32 cell_x, i32 cell_y);
+template <i64 N> i32 grid_cell(SpatialGrid<N> *grid, f32 position);
+template <i64 N> void build_spatial_grid(SpatialGrid<N> *grid, v2 *positions, v2 *sizes, i64 count);
+template <i64 N> void build_spatial_grid(SpatialGrid<N> *grid, v2 *positions, v2 *sizes, Slice<u32> indices);
+template <i64 N> void build_spatial_grid(SpatialGrid<N> *grid, v2 *positions, v2 *sizes, u32 *indices, i64 count);
+template <i64 N> GridQuery new_grid_query(SpatialGrid<N> *grid, v2 position, v2 size);
+template <i64 N> i64 next_candidate(SpatialGrid<N> *grid, GridQuery *query);
+
+i32 sweep_axis(v2 *velocities, Slice<u32> indices);
+SweepItem sweep_interval(i32 axis, v2 position, v2 size, v2 motion);
+int compare_sweep_items(const void *a, const void *b);
+template <i64 N> void build_sweep_list(SweepList<N> *list, i32 axis, v2 *positions, v2 *sizes, v2 *velocities, f32 delta_time, Slice<u32> indices);
+template <i64 N> SweepQuery new_sweep_query(SweepList<N> *list, v2 position, v2 size, v2 motion);
+template <i64 N> i64 next_candidate(SweepList<N> *list, SweepQuery *query);
+
+bool aabb_overlap(v2 position, v2 size, v2 other_position, v2 other_size);
+bool swept_aabb_overlap(v2 position, v2 size, v2 motion, v2 other_position, v2 other_size, v2 other_motion, f32 *hit_time);
+
+// N only picks the bucket count, call it as grid_bucket<N>
+template <i64 N>
+u32 grid_bucket(i32 cell_x, i32 cell_y) {
+    u32 hash = ((u32) cell_x * 73856093u) ^ ((u32) cell_y * 19349663u);
+    return hash & (u32) (SpatialGrid<N>::BUCKET_COUNT - 1);
+}
+
+template <i64 N>
+i32 grid_cell(SpatialGrid<N> *grid, f32 position) {
+    return (i32) floorf(position / grid->cell_size);
+}
+
+template <i64 N>
+void build_spatial_grid(SpatialGrid<N> *grid, v2 *positions, v2 *sizes, i64 count) {
+    build_spatial_grid(grid, positions, sizes, nullptr, count);
+}
+
+// only the entities in indices go in the grid, queries still return
+// indices into positions so this works straight off entities_with_flag
+template <i64 N>
+void build_spatial_grid(SpatialGrid<N> *grid, v2 *positions, v2 *sizes, Slice<u32> indices) {
+    build_spatial_grid(grid, positions, sizes, indices.ptr, indices.len);
+}
+
+// indices can be null to put the first count entities in
+template <i64 N>
+void build_spatial_grid(SpatialGrid<N> *grid, v2 *positions, v2 *sizes, u32 *indices, i64 count) {
+    const i64 BUCKET_COUNT = SpatialGrid<N>::BUCKET_COUNT;
+
+    assert(count <= N);
+
+    grid->cell_size = GRID_CELL_SIZE;
+    grid->max_half_size = {};
+    grid->count = count;
+
+    memset(grid->bucket_starts, 0, sizeof(grid->bucket_starts));
+
+    for (i64 i = 0; i < count; i++) {
+        i64 index = indices ? indices[i] : i;
+
+        i32 cell_x = grid_cell(grid, positions[index].X);
+        i32 cell_y = grid_cell(grid, positions[index].Y);
+        u32 bucket = grid_bucket<N>(cell_x, cell_y);
+
+        grid->item_buckets[i] = bucket;
+        grid->bucket_starts[bucket] += 1;
+
+        grid->max_half_size.X = max(grid->max_half_size.X, sizes[index].X * 0.5f);
+        grid->max_half_size.Y = max(grid->max_half_size.Y, sizes[index].Y * 0.5f);
+    }
+
+    // running total so each bucket start is where the bucket ends, filling
+    // backwards then walks every start back to where it begins and keeps
+    // the items in each bucket in entity order
+    for (i64 b = 1; b < BUCKET_COUNT; b++) {
+        grid->bucket_starts[b] += grid->bucket_starts[b - 1];
+    }
+
+    grid->bucket_starts[BUCKET_COUNT] = (u32) grid->count;
+
+    for (i64 i = grid->count - 1; i >= 0; i--) {
+        u32 bucket = grid->item_buckets[i];
+
+        grid->bucket_starts[bucket] -= 1;
+        grid->items[grid->bucket_starts[bucket]] = indices ? indices[i] : (u32) i;
+    }
+}
+
+template <i64 N>
+GridQuery new_grid_query(SpatialGrid<N> *grid, v2 position, v2 size) {
+    v2 half_size = (size * 0.5f) + grid->max_half_size;
+
+    GridQuery query = {
+        .min_x = grid_cell(grid, position.X - half_size.X),
+        .min_y = grid_cell(grid, position.Y - half_size.Y),
+        .max_x = grid_cell(grid, position.X + half_size.X),
+        .max_y = grid_cell(grid, position.Y + half_size.Y),
+        .item = 0,
+        .item_end = 0,
+    };
+
+    // one before the first cell so the first call to next moves onto it
+    query.cell_x = query.min_x - 1;
+    query.cell_y = query.min_y;
+
+    return query;
+}
+
+// returns the index of the next entity that could be colliding or -1
+// when there are no more, candidates still need a real overlap test
+template <i64 N>
+i64 next_candidate(SpatialGrid<N> *grid, GridQuery *query) {
+    while (true) {
+        if (query->item < query->item_end) {
+            u32 index = grid->items[query->item];
+            query->item++;
+
+            return index;
+        }
+
+        { // move to the next cell in the range
+            query->cell_x++;
+
+            if (query->cell_x > query->max_x) {
+                query->cell_x = query->min_x;
+                query->cell_y++;
+            }
+
+            if (query->cell_y > query->max_y) {
+                return -1;
+            }
+        }
+
+        u32 bucket = grid_bucket<N>(query->cell_x, query->cell_y);
+
+        { // two cells in range can hash to the same bucket, only walk it once
+            bool seen = false;
+
+            for (i32 y = query->min_y; y <= query->cell_y && !seen; y++) {
+                i32 end_x = y == query->cell_y ? query->cell_x : query->max_x + 1;
+
+                for (i32 x = query->min_x; x < end_x; x++) {
+                    if (grid_bucket<N>(x, y) == bucket) {
+                        seen = true;
+                        break;
+                    }
+                }
+            }
+
+            if (seen) {
+                continue;
+            }
+        }
+
+        query->item = grid->bucket_starts[bucket];
+        query->item_end = grid->bucket_starts[bucket + 1];
+    }
+}
+
+i32 sweep_axis(v2 *velocities, Slice<u32> indices) {
+    f32 total_x = 0;
+    f32 total_y = 0;
+
+    for (i64 i = 0; i < indices.len; i++) {
+        v2 velocity = velocities[indices[i]];
+
+        total_x += abs(velocity.X);
+        total_y += abs(velocity.Y);
+    }
+
+    return total_x >= total_y ? 0 : 1;
+}
+
+// the range along axis the box covers moving from position to position + motion
+SweepItem sweep_interval(i32 axis, v2 position, v2 size, v2 motion) {
+    f32 start = position[axis];
+    f32 end = start + motion[axis];
+    f32 half_size = size[axis] * 0.5f;
+
+    return SweepItem {
+        .min = min(start, end) - half_size,
+        .max = max(start, end) + half_size,
+    };
+}
+
+int compare_sweep_items(const void *a, const void *b) {
+    f32 a_min = ((SweepItem *) a)->min;
+    f32 b_min = ((SweepItem *) b)->min;
+
+    return (a_min > b_min) - (a_min < b_min);
+}
+
+template <i64 N>
+void build_sweep_list(SweepList<N> *list, i32 axis, v2 *positions, v2 *sizes, v2 *velocities, f32 delta_time, Slice<u32> indices) {
+    assert(indices.len <= N);
+
+    list->axis = axis;
+    list->max_length = 0;
+    list->count = indices.len;
+
+    for (i64 i = 0; i < indices.len; i++) {
+        u32 index = indices[i];
+
+        SweepItem item = sweep_interval(axis, positions[index], sizes[index], velocities[index] * delta_time);
+        item.index = index;
+
+        list->items[i] = item;
+        list->max_length = max(list->max_length, item.max - item.min);
+    }
+
+    qsort(list->items, list->count, sizeof(SweepItem), compare_sweep_items);
+}
+
+template <i64 N>
+SweepQuery new_sweep_query(SweepList<N> *list, v2 position, v2 size, v2 motion) {
+    SweepItem interval = sweep_interval(list->axis, position, size, motion);
+
+    // nothing can reach the query if it starts more than the longest
+    // interval before it, find the first item past that
+    f32 earliest = interval.min - list->max_length;
+
+    i64 low = 0;
+    i64 high = list->count;
+    while (low < high) {
+        i64 middle = (low + high) / 2;
+
+        if (list->items[middle].min < earliest) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    return SweepQuery {
+        .min = interval.min,
+        .max = interval.max,
+        .item = low,
+    };
+}
+
+// returns the index of the next entity whose interval overlaps the
+// query's or -1 when there are no more, still needs swept_aabb_overlap
+template <i64 N>
+i64 next_candidate(SweepList<N> *list, SweepQuery *query) {
+    while (query->item < list->count) {
+        SweepItem *item = &list->items[query->item];
+        query->item++;
+
+        // sorted by min so nothing after this can overlap
+        if (item->min > query->max) {
+            query->item = list->count;
+            break;
+        }
+
+        if (item->max >= query->min) {
+            return item->index;
+        }
+    }
+
+    return -1;
+}
+
+bool aabb_overlap(v2 position, v2 size, v2 other_position, v2 other_size) {
+    v2 distance = other_position - position;
+    v2 distance_abs = v2{abs(distance.X), abs(distance.Y)};
+    v2 distance_for_collision = (size + other_size) * v2{0.5, 0.5};
+
+    return distance_for_collision[0] >= distance_abs[0] && distance_for_collision[1] >= distance_abs[1];
+}
+
+// do the boxes touch at any point while they both move by their motion,
+// hit_time is when they first touch from 0 (already overlapping) to 1.
+// other is grown by size so this is a ray from position against it, in
+// the frame where other is standing still
+bool swept_aabb_overlap(v2 position, v2 size, v2 motion, v2 other_position, v2 other_size, v2 other_motion, f32 *hit_time) {
+    v2 relative_motion = motion - other_motion;
+    v2 half_size = (size + other_size) * 0.5f;
+
+    f32 enter = 0;
+    f32 exit = 1;
+
+    for (i32 axis = 0; axis < 2; axis++) {
+        f32 box_min = other_position[axis] - half_size[axis];
+        f32 box_max = other_position[axis] + half_size[axis];
+
+        if (relative_motion[axis] == 0) {
+            // not moving on this axis so it has to already be inside the slab
+            if (position[axis] < box_min || position[axis] > box_max) {
+                return false;
+            }
+
+            continue;
+        }
+
+        f32 t0 = (box_min - position[axis]) / relative_motion[axis];
+        f32 t1 = (box_max - position[axis]) / relative_motion[axis];
+
+        enter = max(enter, min(t0, t1));
+        exit = min(exit, max(t0, t1));
+
+        if (enter > exit) {
+            return false;
+        }
+    }
+
+    *hit_time = enter;
+    return true;
+}
+
+#endif
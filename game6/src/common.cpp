@@ -1,10 +1,41 @@
 #ifndef COMMON_CPP
 #define COMMON_CPP
 
+#include <assert.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+
+// the std headers use min, max and abs as names so hmm.cpp's macros
+// cant be defined while they are included
+#pragma push_macro("min")
+#pragma push_macro("max")
+#pragma push_macro("abs")
+#undef min
+#undef max
+#undef abs
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+// map_file
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#define NOGDI
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#pragma pop_macro("min")
+#pragma pop_macro("max")
+#pragma pop_macro("abs")
 
 typedef uint8_t u8;
 typedef uint16_t u16;
@@ -108,6 +139,389 @@ void swap_remove(Array<T, N> *array, i64 index) {
     array->len -= 1;
 }
 
+// one block from malloc that allocations are bumped out of and that is
+// only ever freed all at once with arena_reset, so whatever lives in it
+// costs no heap calls after init
+#define ARENA_ALIGNMENT 16
+
+struct Arena {
+    u8 *data;
+    i64 size;
+    i64 used;
+};
+
+bool init_arena(Arena *arena, i64 size) {
+    arena->data = (u8 *) malloc(size);
+    arena->size = size;
+    arena->used = 0;
+
+    return arena->data != nullptr;
+}
+
+// an empty slice with a null ptr when the arena is full
+template <typename T>
+Slice<T> arena_alloc(Arena *arena, i64 len) {
+    i64 start = (arena->used + ARENA_ALIGNMENT - 1) & ~(i64) (ARENA_ALIGNMENT - 1);
+    i64 end = start + len * (i64) sizeof(T);
+
+    if (end > arena->size) {
+        return make_slice((T *) nullptr, 0);
+    }
+
+    arena->used = end;
+    return make_slice((T *) (arena->data + start), len);
+}
+
+void arena_reset(Arena *arena) {
+    arena->used = 0;
+}
+
+// fnv-1a
+u64 hash_bytes(Slice<u8> bytes) {
+    u64 hash = 14695981039346656037ull;
+
+    for (i64 i = 0; i < bytes.len; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+
+    return hash;
+}
+
+// the codepoint at index in text and moves index past it. anything that
+// isn't valid utf-8 comes out as U+FFFD one byte at a time
+u32 decode_utf8(string text, i64 *index) {
+    u8 first = text[*index];
+
+    if (first < 0x80) {
+        *index += 1;
+        return first;
+    }
+
+    i64 length = 0;
+    u32 codepoint = 0;
+
+    if ((first & 0xE0) == 0xC0) {
+        length = 2;
+        codepoint = first & 0x1F;
+    } else if ((first & 0xF0) == 0xE0) {
+        length = 3;
+        codepoint = first & 0x0F;
+    } else if ((first & 0xF8) == 0xF0) {
+        length = 4;
+        codepoint = first & 0x07;
+    }
+
+    if (length == 0 || *index + length > text.len) {
+        *index += 1;
+        return 0xFFFD;
+    }
+
+    for (i64 i = 1; i < length; i++) {
+        u8 next = text[*index + i];
+        if ((next & 0xC0) != 0x80) {
+            *index += 1;
+            return 0xFFFD;
+        }
+
+        codepoint = (codepoint << 6) | (next & 0x3F);
+    }
+
+    // overlong encodings, surrogates and past the last codepoint
+    const u32 smallest[5] = {0, 0, 0x80, 0x800, 0x10000};
+    if (codepoint < smallest[length] || codepoint > 0x10FFFF || (codepoint >= 0xD800 && codepoint <= 0xDFFF)) {
+        *index += 1;
+        return 0xFFFD;
+    }
+
+    *index += length;
+    return codepoint;
+}
+
+// fixed size queue for one thread to push into and one to pop from with
+// no locks, push never waits, if it is full the value is dropped and
+// counted instead. read and write only ever go up, the slot is the
+// count masked by N so N has to be a power of 2
+template <typename T, i64 N>
+struct RingBuffer {
+    static_assert((N & (N - 1)) == 0, "ring buffer size has to be a power of 2");
+
+    T data[N];
+
+    std::atomic<u64> write;
+    std::atomic<u64> read;
+    std::atomic<u64> dropped;
+};
+
+template <typename T, i64 N>
+bool ring_push(RingBuffer<T, N> *ring, T value) {
+    u64 write = ring->write.load(std::memory_order_relaxed);
+    u64 read = ring->read.load(std::memory_order_acquire);
+
+    if (write - read >= (u64) N) {
+        ring->dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    ring->data[write & (N - 1)] = value;
+    ring->write.store(write + 1, std::memory_order_release);
+
+    return true;
+}
+
+template <typename T, i64 N>
+bool ring_pop(RingBuffer<T, N> *ring, T *value) {
+    u64 read = ring->read.load(std::memory_order_relaxed);
+    u64 write = ring->write.load(std::memory_order_acquire);
+
+    if (read == write) {
+        return false;
+    }
+
+    *value = ring->data[read & (N - 1)];
+    ring->read.store(read + 1, std::memory_order_release);
+
+    return true;
+}
+
+// work stealing job system. every thread (the one that called init is
+// thread 0) has its own deque of jobs, it pushes and pops at the bottom
+// and other threads steal from the top when they run out. parallel_for
+// pushes one job for the whole range, whoever runs a job bigger than the
+// grain splits it in half, pushes the back half and keeps going with the
+// front, so idle threads steal big chunks and the owner works through
+// small ones. the calling thread helps until the whole range is done.
+// any thread that finds nothing to run sleeps until a job is pushed or
+// its parallel_for finishes
+
+#define MAX_JOB_THREADS 32
+#define JOB_DEQUE_SIZE 256
+
+typedef void (*JobFunction)(void *data, i64 start, i64 end);
+
+struct Job {
+    JobFunction function;
+    void *data;
+    i64 start;
+    i64 end;
+    i64 grain;
+    std::atomic<i64> *remaining;
+};
+
+struct JobDeque {
+    std::mutex lock;
+    Job jobs[JOB_DEQUE_SIZE];
+    i64 top;    // stolen from here
+    i64 bottom; // owner pushes and pops here
+};
+
+struct JobSystem {
+    i64 thread_count;
+    std::thread threads[MAX_JOB_THREADS];
+    JobDeque deques[MAX_JOB_THREADS];
+
+    std::atomic<i64> queued; // jobs in all the deques
+    std::atomic<i64> sleeping;
+    std::atomic<bool> running;
+    std::mutex sleep_lock;
+    std::condition_variable wake;
+};
+
+thread_local i64 job_thread_index = 0;
+
+i64 hardware_thread_count();
+bool init_job_system(JobSystem *system, i64 thread_count);
+void shutdown_job_system(JobSystem *system);
+void parallel_for(JobSystem *system, i64 count, i64 grain, JobFunction function, void *data);
+void push_job(JobSystem *system, Job job);
+bool find_job(JobSystem *system, Job *job);
+void run_job(JobSystem *system, Job job);
+void job_worker(JobSystem *system, i64 index);
+void wake_sleepers(JobSystem *system, bool all);
+
+i64 hardware_thread_count() {
+    i64 count = (i64) std::thread::hardware_concurrency();
+    return count > 0 ? count : 1;
+}
+
+bool init_job_system(JobSystem *system, i64 thread_count) {
+    if (thread_count < 1 || thread_count > MAX_JOB_THREADS) {
+        printf("job system needs 1 to %d threads, got %lld\n", MAX_JOB_THREADS, (long long) thread_count);
+        return false;
+    }
+
+    system->thread_count = thread_count;
+    system->queued = 0;
+    system->sleeping = 0;
+    system->running = true;
+
+    for (i64 i = 0; i < thread_count; i++) {
+        system->deques[i].top = 0;
+        system->deques[i].bottom = 0;
+    }
+
+    for (i64 i = 1; i < thread_count; i++) {
+        system->threads[i] = std::thread(job_worker, system, i);
+    }
+
+    return true;
+}
+
+void shutdown_job_system(JobSystem *system) {
+    {
+        std::lock_guard<std::mutex> guard(system->sleep_lock);
+        system->running = false;
+    }
+    system->wake.notify_all();
+
+    for (i64 i = 1; i < system->thread_count; i++) {
+        system->threads[i].join();
+    }
+
+    system->thread_count = 0;
+}
+
+// calls function(data, start, end) over 0 -> count in pieces of at most
+// grain, returns once every piece is done. function runs on any thread
+// at the same time as other pieces so it can only write to its own range
+void parallel_for(JobSystem *system, i64 count, i64 grain, JobFunction function, void *data) {
+    if (count <= 0) {
+        return;
+    }
+
+    // not worth waking anything up for
+    if (system->thread_count <= 1 || count <= grain) {
+        function(data, 0, count);
+        return;
+    }
+
+    std::atomic<i64> remaining = count;
+
+    run_job(system, Job {
+        .function = function,
+        .data = data,
+        .start = 0,
+        .end = count,
+        .grain = max(grain, (i64) 1),
+        .remaining = &remaining,
+    });
+
+    while (remaining.load(std::memory_order_acquire) > 0) {
+        Job job = {};
+        if (find_job(system, &job)) {
+            run_job(system, job);
+            continue;
+        }
+
+        // the last pieces are running on other threads
+        std::unique_lock<std::mutex> lock(system->sleep_lock);
+        system->sleeping += 1;
+        system->wake.wait(lock, [system, &remaining] { return remaining.load() == 0 || system->queued > 0; });
+        system->sleeping -= 1;
+    }
+}
+
+void push_job(JobSystem *system, Job job) {
+    JobDeque *deque = &system->deques[job_thread_index];
+    std::lock_guard<std::mutex> guard(deque->lock);
+
+    assert(deque->bottom - deque->top < JOB_DEQUE_SIZE);
+
+    deque->jobs[deque->bottom % JOB_DEQUE_SIZE] = job;
+    deque->bottom += 1;
+
+    system->queued += 1;
+    wake_sleepers(system, false);
+}
+
+// newest job from our own deque, otherwise the oldest one from someone else's
+bool find_job(JobSystem *system, Job *job) {
+    { // own
+        JobDeque *deque = &system->deques[job_thread_index];
+        std::lock_guard<std::mutex> guard(deque->lock);
+
+        if (deque->bottom > deque->top) {
+            deque->bottom -= 1;
+            *job = deque->jobs[deque->bottom % JOB_DEQUE_SIZE];
+            system->queued -= 1;
+            return true;
+        }
+    }
+
+    for (i64 i = 1; i < system->thread_count; i++) {
+        JobDeque *deque = &system->deques[(job_thread_index + i) % system->thread_count];
+        std::lock_guard<std::mutex> guard(deque->lock);
+
+        if (deque->bottom > deque->top) {
+            *job = deque->jobs[deque->top % JOB_DEQUE_SIZE];
+            deque->top += 1;
+            system->queued -= 1;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void run_job(JobSystem *system, Job job) {
+    while (job.end - job.start > job.grain) {
+        i64 middle = job.start + ((job.end - job.start) / 2);
+
+        Job back = job;
+        back.start = middle;
+        push_job(system, back);
+
+        job.end = middle;
+    }
+
+    job.function(job.data, job.start, job.end);
+
+    // the caller might be asleep waiting for this piece
+    if (job.remaining->fetch_sub(job.end - job.start) == job.end - job.start) {
+        wake_sleepers(system, true);
+    }
+}
+
+void job_worker(JobSystem *system, i64 index) {
+    job_thread_index = index;
+
+    while (true) {
+        Job job = {};
+        if (find_job(system, &job)) {
+            run_job(system, job);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(system->sleep_lock);
+        system->sleeping += 1;
+        system->wake.wait(lock, [system] { return system->queued > 0 || !system->running; });
+        system->sleeping -= 1;
+
+        if (!system->running) {
+            return;
+        }
+    }
+}
+
+// sleepers check what they wait on under sleep_lock and count themselves
+// before they do, so taking the lock here means one that missed the
+// change is already waiting and gets the notify
+void wake_sleepers(JobSystem *system, bool all) {
+    if (system->sleeping == 0) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(system->sleep_lock);
+    }
+
+    if (all) {
+        system->wake.notify_all();
+    } else {
+        system->wake.notify_one();
+    }
+}
+
 Slice<u8> read_file(const char *path) {
     FILE *file = fopen(path, "rb");
     if (file == nullptr) {
@@ -127,6 +541,63 @@ Slice<u8> read_file(const char *path) {
     return make_slice(data, file_size);
 }
 
+// the file read only in place without copying it, pages are only read
+// in when they are touched. empty if it can't be opened. there is no
+// unmap, whatever is mapped stays for the whole run
+Slice<u8> map_file(const char *path) {
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return make_slice((u8 *) nullptr, 0);
+    }
+
+    LARGE_INTEGER file_size = {};
+    GetFileSizeEx(file, &file_size);
+
+    HANDLE mapping = file_size.QuadPart > 0 ? CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+    CloseHandle(file);
+    if (mapping == nullptr) {
+        return make_slice((u8 *) nullptr, 0);
+    }
+
+    // the view keeps the mapping alive
+    void *data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (data == nullptr) {
+        return make_slice((u8 *) nullptr, 0);
+    }
+
+    return make_slice((u8 *) data, (i64) file_size.QuadPart);
+#else
+    int file = open(path, O_RDONLY);
+    if (file < 0) {
+        return make_slice((u8 *) nullptr, 0);
+    }
+
+    struct stat info = {};
+    if (fstat(file, &info) != 0 || info.st_size == 0) {
+        close(file);
+        return make_slice((u8 *) nullptr, 0);
+    }
+
+    void *data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    if (data == MAP_FAILED) {
+        return make_slice((u8 *) nullptr, 0);
+    }
+
+    return make_slice((u8 *) data, (i64) info.st_size);
+#endif
+}
+
+// seconds, only useful for measuring the time between two calls
+f64 time_now() {
+    timespec time = {};
+    timespec_get(&time, TIME_UTC);
+
+    return (f64) time.tv_sec + ((f64) time.tv_nsec / 1000000000.0);
+}
+
 // 0 -> 1
 f32 rand_f32() {
     return (f32) rand() / (f32) RAND_MAX;
@@ -0,0 +1,397 @@
+#ifndef ENTITY_CPP
+#define ENTITY_CPP
+
+#include "hmm.cpp"
+#include "common.cpp"
+
+#ifdef __AVX__
+#include <immintrin.h>
+#endif
+
+// entities are stored as parallel arrays instead of one array of structs
+// so the loops that only need positions and velocities (physics, the
+// collision grid) dont pull the rest of the entity through the cache.
+// anything only the draw path needs goes in the game defined Cold type.
+// every array is aligned so they can be worked on with simd
+//
+// the arrays are kept packed so indices move around when entities are
+// removed, anything that needs to hold onto an entity across frames keeps
+// an EntityHandle instead. handles point at a slot which knows where the
+// entity currently is, and the generation is bumped every time the slot
+// is freed so old handles stop resolving. removals only happen in
+// compact_entities at the end of the frame so indices are stable for the
+// whole frame
+
+#define ENTITY_ALIGNMENT 32
+
+// a store can also keep a list of every entity with a given flag so game
+// code can loop just the asteroids or just the missles instead of every
+// entity and a flag test. the lists are kept up to date by add_entity,
+// compact_entities and set_entity_flags, so a tracked flag must only be
+// changed through set_entity_flags. lists hold indices so like indices
+// they are only good until the next compact
+#ifndef ENTITY_FLAG_BUCKETS
+#define ENTITY_FLAG_BUCKETS 4
+#endif
+
+template <i64 N>
+struct FlagBucket {
+    u64 flag;
+    i64 len;
+    u32 entities[N];
+};
+
+// zero is never a valid generation so a zeroed handle is always null
+struct EntityHandle {
+    u32 slot;
+    u32 generation;
+};
+
+struct EntitySlot {
+    u32 generation;
+    u32 index;
+};
+
+template <typename Cold, i64 N>
+struct EntityStore {
+    i64 len;
+
+    EntitySlot slots[N];
+    i64 slot_count;
+
+    u32 free_slots[N];
+    i64 free_slot_count;
+
+    // hot, touched by physics and collision every frame
+    alignas(ENTITY_ALIGNMENT) v2 positions[N];
+    alignas(ENTITY_ALIGNMENT) v2 velocities[N];
+    alignas(ENTITY_ALIGNMENT) v2 sizes[N];
+    alignas(ENTITY_ALIGNMENT) f32 rotations[N];
+    alignas(ENTITY_ALIGNMENT) u64 flags[N];
+
+    // where the hot values were at the start of the tick, the draw path
+    // blends from these to the current ones
+    alignas(ENTITY_ALIGNMENT) v2 previous_positions[N];
+    alignas(ENTITY_ALIGNMENT) f32 previous_rotations[N];
+
+    // cold, only touched when drawing
+    Cold cold[N];
+
+    // which slot each entity belongs to
+    u32 index_slots[N];
+
+    FlagBucket<N> buckets[ENTITY_FLAG_BUCKETS];
+    i64 bucket_count;
+};
+
+// references into every array for one entity so game code can keep
+// reading entity.position without caring how the entity is stored, only
+// valid until the store is next changed
+template <typename Cold>
+struct EntityRef {
+    i64 index;
+    EntityHandle handle;
+
+    u64 &flags;
+    v2 &position;
+    v2 &velocity;
+    v2 &size;
+    f32 &rotation;
+    Cold &cold;
+};
+
+template <typename Cold, i64 N> EntityHandle add_entity(EntityStore<Cold, N> *store, u64 flags, v2 position, v2 size, f32 rotation, v2 velocity, Cold cold);
+template <typename Cold, i64 N> i64 compact_entities(EntityStore<Cold, N> *store, u64 delete_flag);
+template <typename Cold, i64 N> void store_previous_state(EntityStore<Cold, N> *store);
+template <typename Cold, i64 N> EntityRef<Cold> get_entity(EntityStore<Cold, N> *store, i64 index);
+template <typename Cold, i64 N> EntityHandle entity_handle(EntityStore<Cold, N> *store, i64 index);
+template <typename Cold, i64 N> i64 entity_index(EntityStore<Cold, N> *store, EntityHandle handle);
+template <typename Cold, i64 N> void track_flag(EntityStore<Cold, N> *store, u64 flag);
+template <typename Cold, i64 N> Slice<u32> entities_with_flag(EntityStore<Cold, N> *store, u64 flag);
+template <typename Cold, i64 N> void set_entity_flags(EntityStore<Cold, N> *store, i64 index, u64 flags);
+
+void integrate_positions(v2 *positions, v2 *velocities, i64 count, f32 delta_time);
+void integrate_positions_scalar(v2 *positions, v2 *velocities, i64 count, f32 delta_time);
+
+template <typename Cold, i64 N>
+EntityHandle add_entity(EntityStore<Cold, N> *store, u64 flags, v2 position, v2 size, f32 rotation, v2 velocity, Cold cold) {
+    assert(store->len < N);
+
+    i64 index = store->len;
+    store->len += 1;
+
+    u32 slot = 0;
+    if (store->free_slot_count > 0) {
+        store->free_slot_count -= 1;
+        slot = store->free_slots[store->free_slot_count];
+    } else {
+        slot = (u32) store->slot_count;
+        store->slot_count += 1;
+
+        store->slots[slot].generation = 1;
+    }
+
+    store->slots[slot].index    = (u32) index;
+    store->index_slots[index]   = slot;
+
+    store->positions[index]     = position;
+    store->velocities[index]    = velocity;
+    store->sizes[index]         = size;
+    store->rotations[index]     = rotation;
+    store->flags[index]         = flags;
+    store->cold[index]          = cold;
+
+    store->previous_positions[index] = position;
+    store->previous_rotations[index] = rotation;
+
+    for (i64 b = 0; b < store->bucket_count; b++) {
+        FlagBucket<N> *bucket = &store->buckets[b];
+
+        if (flags & bucket->flag) {
+            bucket->entities[bucket->len] = (u32) index;
+            bucket->len += 1;
+        }
+    }
+
+    return EntityHandle {
+        .slot = slot,
+        .generation = store->slots[slot].generation,
+    };
+}
+
+// removes every entity with delete_flag set in one pass, the rest slide
+// down so they stay in the same order, returns how many were removed.
+// the flag buckets are refilled in the same pass so they come out in
+// index order too
+template <typename Cold, i64 N>
+i64 compact_entities(EntityStore<Cold, N> *store, u64 delete_flag) {
+    i64 write = 0;
+
+    for (i64 b = 0; b < store->bucket_count; b++) {
+        store->buckets[b].len = 0;
+    }
+
+    for (i64 read = 0; read < store->len; read++) {
+        u32 slot = store->index_slots[read];
+
+        if (store->flags[read] & delete_flag) {
+            store->slots[slot].generation += 1;
+            if (store->slots[slot].generation == 0) {
+                store->slots[slot].generation = 1;
+            }
+
+            store->free_slots[store->free_slot_count] = slot;
+            store->free_slot_count += 1;
+
+            continue;
+        }
+
+        if (write != read) {
+            store->positions[write]     = store->positions[read];
+            store->velocities[write]    = store->velocities[read];
+            store->sizes[write]         = store->sizes[read];
+            store->rotations[write]     = store->rotations[read];
+            store->flags[write]         = store->flags[read];
+            store->cold[write]          = store->cold[read];
+            store->index_slots[write]   = slot;
+
+            store->previous_positions[write] = store->previous_positions[read];
+            store->previous_rotations[write] = store->previous_rotations[read];
+
+            store->slots[slot].index = (u32) write;
+        }
+
+        for (i64 b = 0; b < store->bucket_count; b++) {
+            FlagBucket<N> *bucket = &store->buckets[b];
+
+            if (store->flags[write] & bucket->flag) {
+                bucket->entities[bucket->len] = (u32) write;
+                bucket->len += 1;
+            }
+        }
+
+        write++;
+    }
+
+    i64 removed = store->len - write;
+    store->len = write;
+
+    return removed;
+}
+
+template <typename Cold, i64 N>
+void store_previous_state(EntityStore<Cold, N> *store) {
+    memcpy(store->previous_positions, store->positions, sizeof(v2) * store->len);
+    memcpy(store->previous_rotations, store->rotations, sizeof(f32) * store->len);
+}
+
+template <typename Cold, i64 N>
+EntityRef<Cold> get_entity(EntityStore<Cold, N> *store, i64 index) {
+    assert(index < store->len);
+
+    return EntityRef<Cold> {
+        .index = index,
+        .handle = entity_handle(store, index),
+        .flags = store->flags[index],
+        .position = store->positions[index],
+        .velocity = store->velocities[index],
+        .size = store->sizes[index],
+        .rotation = store->rotations[index],
+        .cold = store->cold[index],
+    };
+}
+
+template <typename Cold, i64 N>
+EntityHandle entity_handle(EntityStore<Cold, N> *store, i64 index) {
+    assert(index < store->len);
+
+    u32 slot = store->index_slots[index];
+
+    return EntityHandle {
+        .slot = slot,
+        .generation = store->slots[slot].generation,
+    };
+}
+
+// returns where the entity is right now or -1 if it has been removed
+template <typename Cold, i64 N>
+i64 entity_index(EntityStore<Cold, N> *store, EntityHandle handle) {
+    if (handle.generation == 0 || handle.slot >= store->slot_count) {
+        return -1;
+    }
+
+    EntitySlot *slot = &store->slots[handle.slot];
+    if (slot->generation != handle.generation) {
+        return -1;
+    }
+
+    return slot->index;
+}
+
+// start keeping a list of every entity with flag set, can be called with
+// entities already in the store
+template <typename Cold, i64 N>
+void track_flag(EntityStore<Cold, N> *store, u64 flag) {
+    assert(store->bucket_count < ENTITY_FLAG_BUCKETS);
+
+    FlagBucket<N> *bucket = &store->buckets[store->bucket_count];
+    store->bucket_count += 1;
+
+    bucket->flag = flag;
+    bucket->len = 0;
+
+    for (i64 i = 0; i < store->len; i++) {
+        if (store->flags[i] & flag) {
+            bucket->entities[bucket->len] = (u32) i;
+            bucket->len += 1;
+        }
+    }
+}
+
+// indices of every entity with flag, the flag has to be tracked
+template <typename Cold, i64 N>
+Slice<u32> entities_with_flag(EntityStore<Cold, N> *store, u64 flag) {
+    for (i64 b = 0; b < store->bucket_count; b++) {
+        FlagBucket<N> *bucket = &store->buckets[b];
+
+        if (bucket->flag == flag) {
+            return make_slice(bucket->entities, bucket->len);
+        }
+    }
+
+    assert(0);
+    return {};
+}
+
+// changes flags and moves the entity in or out of any bucket that cares.
+// flags only change a handful of times a frame so removing just searches
+// the bucket
+template <typename Cold, i64 N>
+void set_entity_flags(EntityStore<Cold, N> *store, i64 index, u64 flags) {
+    assert(index < store->len);
+
+    u64 old_flags = store->flags[index];
+    store->flags[index] = flags;
+
+    for (i64 b = 0; b < store->bucket_count; b++) {
+        FlagBucket<N> *bucket = &store->buckets[b];
+
+        bool was_in = (old_flags & bucket->flag) != 0;
+        bool now_in = (flags & bucket->flag) != 0;
+
+        if (now_in && !was_in) {
+            bucket->entities[bucket->len] = (u32) index;
+            bucket->len += 1;
+        }
+
+        if (was_in && !now_in) {
+            for (i64 i = 0; i < bucket->len; i++) {
+                if (bucket->entities[i] == (u32) index) {
+                    bucket->entities[i] = bucket->entities[bucket->len - 1];
+                    bucket->len -= 1;
+                    break;
+                }
+            }
+        }
+    }
+}
+
+// position += velocity * delta_time for every entity. positions and
+// velocities are x, y pairs so one register holds 2 (sse) or 4 (avx)
+// entities, each loop does two registers so 4 or 8 entities at a time.
+// both arrays have to be ENTITY_ALIGNMENT aligned like the store ones,
+// avx is used when the compiler is allowed to (/arch:AVX2, -mavx2) and
+// sse goes off what hmm.cpp decided
+void integrate_positions(v2 *positions, v2 *velocities, i64 count, f32 delta_time) {
+    f32 *position = (f32 *) positions;
+    f32 *velocity = (f32 *) velocities;
+
+    i64 i = 0;
+    i64 float_count = count * 2;
+
+#if defined(__AVX__)
+    __m256 dt = _mm256_set1_ps(delta_time);
+
+    for (; i + 16 <= float_count; i += 16) {
+        __m256 position_a = _mm256_load_ps(position + i);
+        __m256 position_b = _mm256_load_ps(position + i + 8);
+        __m256 velocity_a = _mm256_load_ps(velocity + i);
+        __m256 velocity_b = _mm256_load_ps(velocity + i + 8);
+
+        position_a = _mm256_add_ps(position_a, _mm256_mul_ps(velocity_a, dt));
+        position_b = _mm256_add_ps(position_b, _mm256_mul_ps(velocity_b, dt));
+
+        _mm256_store_ps(position + i, position_a);
+        _mm256_store_ps(position + i + 8, position_b);
+    }
+#elif defined(HANDMADE_MATH__USE_SSE)
+    __m128 dt = _mm_set1_ps(delta_time);
+
+    for (; i + 8 <= float_count; i += 8) {
+        __m128 position_a = _mm_load_ps(position + i);
+        __m128 position_b = _mm_load_ps(position + i + 4);
+        __m128 velocity_a = _mm_load_ps(velocity + i);
+        __m128 velocity_b = _mm_load_ps(velocity + i + 4);
+
+        position_a = _mm_add_ps(position_a, _mm_mul_ps(velocity_a, dt));
+        position_b = _mm_add_ps(position_b, _mm_mul_ps(velocity_b, dt));
+
+        _mm_store_ps(position + i, position_a);
+        _mm_store_ps(position + i + 4, position_b);
+    }
+#endif
+
+    // whatever didnt fit in a full batch, or everything with no simd
+    for (; i < float_count; i++) {
+        position[i] += velocity[i] * delta_time;
+    }
+}
+
+void integrate_positions_scalar(v2 *positions, v2 *velocities, i64 count, f32 delta_time) {
+    for (i64 i = 0; i < count; i++) {
+        positions[i].X += velocities[i].X * delta_time;
+        positions[i].Y += velocities[i].Y * delta_time;
+    }
+}
+
+#endif
@@ -0,0 +1,63 @@
+// bakes the game's font in both modes with the settings main.cpp loads
+// them at and writes the blobs load_font_blob maps, so the game starts
+// without baking anything. the png of each atlas that the game used to
+// write every time it started is written here instead. build_bench and
+// build run it after building, run it again after changing the font or
+// its settings, the game says when a blob is stale and bakes the ttf
+//
+// run from the game6 folder so resources/ and build/ are found
+//
+//     font_bake
+
+#define HEADLESS
+
+#include "main.cpp"
+
+int main(int argc, char **argv) {
+    Renderer *renderer = &state.renderer;
+
+    // cache_glyph counts what it does in the current packet's stats
+    renderer->packet = &renderer->packets[0];
+
+    Slice<u8> font_data = read_file(FONT_PATH);
+    if (font_data.len == 0) {
+        printf("failed to load font \"%s\"\n", FONT_PATH);
+        return 1;
+    }
+
+    FontMode modes[] = {FM_BAKED, FM_SDF};
+    const char *png_paths[] = {"build/font_baked.png", "build/font_sdf.png"};
+
+    for (i64 i = 0; i < 2; i++) {
+        FontMode mode = modes[i];
+        FontSettings settings = game_font_settings(mode);
+        f64 start = time_now();
+
+        renderer->font_mode = mode;
+
+        bool ok = mode == FM_SDF ? bake_sdf_font(renderer, font_data, settings) : bake_font(renderer, font_data, settings);
+        if (!ok) {
+            printf("failed to bake font \"%s\"\n", FONT_PATH);
+            return 1;
+        }
+
+        f64 bake_time = time_now() - start;
+
+        ok = write_font_blob(renderer, settings, font_blob_path(mode));
+        if (!ok) {
+            return 1;
+        }
+
+        Font *font = &renderer->font;
+
+        stbi_flip_vertically_on_write(false);
+        if (!stbi_write_png(png_paths[i], font->width, font->height, 1, font->bitmap_data, font->width)) {
+            printf("error writing font to build folder\n");
+            return 1;
+        }
+
+        printf("%s: %.1f ms to bake, written to %s\n", FONT_PATH, bake_time * 1000.0, font_blob_path(mode));
+    }
+
+    return 0;
+}
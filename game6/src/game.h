@@ -3,6 +3,9 @@
 
 #include "hmm.cpp"
 #include "common.cpp"
+#include "collision.cpp"
+#include "entity.cpp"
+#include "quad.cpp"
 #include "window.cpp"
 #include "renderer.cpp"
 #include "sound.cpp"
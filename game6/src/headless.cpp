@@ -0,0 +1,417 @@
+// the real game with the null backend from backend.h, no window, gl or
+// sound. the player spins and fires on its own while an asteroid storm
+// is spawned around it and every phase of the frame is timed so changes
+// to the simulation and the cpu side of the renderer can be measured
+// with a profiler attached, see build_bench.bat/.sh
+//
+// run from the game6 folder so resources/ and build/ are found
+//
+//     headless [frames] [asteroids per second] [ticks per frame] [seed] [threads] [render path] [vertex format] [render thread] [swap ms] [font mode] [labels]
+//
+// render path is 0 for cpu built vertices and 1 for instanced, vertex
+// format is 0 for floats and 1 for packed and only matters on path 0.
+// render thread is 1 to draw on a render thread like the game and 0 to
+// draw on the game thread. swap ms is how long each glfwSwapBuffers
+// blocks, standing in for vsync. font mode is 0 for the baked bitmap
+// and 1 for the distance field. labels is how many labels a frame
+// bench_labels draws after the run, 0 to skip it. on the instanced path
+// check_draw_order runs last and headless exits with 1 if it fails
+
+#define HEADLESS
+
+#define MAX_ENTITIES 20000
+
+#include "main.cpp"
+
+// how many storm waves a second, each one spawns asteroids_per_spawn
+#define STORM_WAVE_RATE 10
+#define FIRE_EVERY_TICKS 4
+
+#define LABEL_BENCH_FRAMES 100
+#define DRAW_ORDER_QUADS 2000
+
+#define USAGE "usage: headless [frames] [asteroids per second] [ticks per frame] [seed] [threads] [render path] [vertex format] [render thread] [swap ms] [font mode] [labels]\n"
+
+void bench_labels(i64 count, i64 frames);
+bool check_draw_order(i64 count);
+bool integer_argument(int argc, char **argv, i64 index, i64 min, i64 max, i64 *value);
+bool number_argument(int argc, char **argv, i64 index, f64 min, f64 *value);
+
+int main(int argc, char **argv) {
+    i64 frames = 1200;
+    i64 asteroids_a_second = 200;
+    i64 ticks_per_frame = 1;
+    i64 seed = 1234;
+    i64 threads = 0;
+    i64 path = RP_INSTANCED;
+    i64 format = VF_FLOATS;
+    i64 thread = 1;
+    f64 swap_ms = 0;
+    i64 mode = FM_SDF;
+    i64 label_count = 0;
+
+    bool ok = integer_argument(argc, argv, 1, 1, INT64_MAX, &frames) &&
+              integer_argument(argc, argv, 2, 0, INT64_MAX, &asteroids_a_second) &&
+              integer_argument(argc, argv, 3, 1, INT64_MAX, &ticks_per_frame) &&
+              integer_argument(argc, argv, 4, 0, UINT32_MAX, &seed) &&
+              integer_argument(argc, argv, 5, 0, MAX_JOB_THREADS, &threads) &&
+              integer_argument(argc, argv, 6, 0, 1, &path) &&
+              integer_argument(argc, argv, 7, 0, 1, &format) &&
+              integer_argument(argc, argv, 8, 0, 1, &thread) &&
+              number_argument(argc, argv, 9, 0, &swap_ms) &&
+              integer_argument(argc, argv, 10, 0, 1, &mode) &&
+              integer_argument(argc, argv, 11, 0, INT64_MAX, &label_count);
+
+    if (!ok || argc > 12) {
+        printf(USAGE);
+        return 1;
+    }
+
+    job_thread_count = threads;
+    render_path = (RenderPath) path;
+    vertex_format = (VertexFormat) format;
+    render_thread = thread != 0;
+    null_glfw_swap_time = swap_ms / 1000.0;
+    font_mode = (FontMode) mode;
+
+    ok = init();
+    if (!ok) {
+        return 1;
+    }
+
+    // init seeds from the clock, runs need to be repeatable
+    srand((u32) seed);
+
+    state.asteroid_spawn_rate = 1.0f / STORM_WAVE_RATE;
+    state.asteroids_per_spawn = max(asteroids_a_second / STORM_WAVE_RATE, (i64) 1);
+
+    i64 total_ticks = 0;
+    i64 peak_entities = 0;
+    i64 player_deaths = 0;
+
+    f64 start = time_now();
+
+    for (i64 frame = 0; frame < frames; frame++) {
+        input();
+
+        for (i64 i = 0; i < ticks_per_frame; i++) {
+            if (entity_index(&state.entities, state.player) < 0) {
+                spawn_player();
+                player_deaths += 1;
+            }
+
+            // down turns into pressed after the tick so this is one missle
+            KEYS[GLFW_KEY_D] = InputState::pressed;
+            KEYS[GLFW_KEY_SPACE] = (total_ticks % FIRE_EVERY_TICKS == 0) ? InputState::down : InputState::up;
+
+            tick();
+            total_ticks += 1;
+
+            peak_entities = max(peak_entities, state.entities.len);
+        }
+
+        drain_destroy_events();
+
+        begin_phase(PH_DRAW);
+        new_frame(&state.renderer, &state.window, state.camera);
+        draw(0);
+        end_phase(PH_DRAW);
+
+        begin_phase(PH_SUBMIT);
+        draw_frame(&state.renderer, &state.window);
+        end_phase(PH_SUBMIT);
+    }
+
+    wait_for_frames(&state.renderer);
+    f64 total_time = time_now() - start;
+
+    RenderStats totals = get_total_stats(&state.renderer);
+    i64 total_quads = totals.quads;
+    i64 total_culled = totals.culled;
+    i64 total_bytes_uploaded = totals.bytes_uploaded;
+
+    printf("%lld frames, %lld ticks, %lld asteroids/s, seed %lld, %lld threads\n",
+        (long long) frames, (long long) total_ticks, (long long) asteroids_a_second, (long long) seed, (long long) jobs.thread_count);
+    printf("  %lld entities at the end, %lld peak, score %lld, player died %lld times\n",
+        (long long) state.entities.len, (long long) peak_entities, (long long) state.score, (long long) player_deaths);
+    printf("  %.3f s total, %.1f ticks/s, %.2f M quads/s drawn, %.0f pair tests/tick\n",
+        total_time, (f64) total_ticks / total_time, (f64) total_quads / total_time / 1e6, (f64) state.pair_tests / (f64) total_ticks);
+
+    const char *path_names[] = {"vertices", "instanced"};
+    const char *format_names[] = {"floats", "packed"};
+    // building the frame on the game thread and drawing it on whichever
+    f64 quad_time = state.phase_times[PH_DRAW] + totals.render_time;
+    i64 total_pushed = total_quads + total_culled;
+    printf("  %s path (%s): %.1f ns/quad pushed to draw and submit, %.1f KB/frame uploaded, %lld bytes/quad\n",
+        path_names[state.renderer.path], format_names[state.renderer.format], quad_time * 1e9 / (f64) max(total_pushed, (i64) 1),
+        (f64) total_bytes_uploaded / (f64) frames / 1024.0, (long long) (total_bytes_uploaded / max(total_quads, (i64) 1)));
+    printf("  %.1f quads/frame drawn, %.1f culled (%.1f%%)\n",
+        (f64) total_quads / (f64) frames, (f64) total_culled / (f64) frames, 100.0 * (f64) total_culled / (f64) max(total_pushed, (i64) 1));
+    printf("  %.1f batches/frame, %.1f draw calls/frame, %lld quads a batch\n",
+        (f64) totals.batches / (f64) frames, (f64) totals.draw_calls / (f64) frames, (long long) BATCH_QUADS);
+    printf("  %.1f program switches/frame, %.1f material runs/frame in push order, %.1f us/frame sorting commands\n",
+        (f64) totals.program_switches / (f64) frames, (f64) totals.push_runs / (f64) frames, totals.sort_time * 1e6 / (f64) frames);
+    printf("  %.1f flushes/frame to keep overlapping materials in order\n", (f64) totals.order_flushes / (f64) frames);
+    printf("  %.1f text layouts/frame cached, %.1f laid out\n",
+        (f64) totals.text_cached / (f64) frames, (f64) totals.text_laid_out / (f64) frames);
+    printf("  %lld glyphs rasterized, %lld glyph pages evicted, %lld glyphs dropped, %.1f KB of glyphs uploaded\n",
+        (long long) totals.glyphs_rasterized, (long long) totals.glyph_pages_evicted, (long long) totals.glyphs_dropped,
+        (f64) totals.font_bytes_uploaded / 1024.0);
+    printf("  Kpixels/frame: %.1f rectangle, %.1f circle, %.1f texture, %.1f font\n",
+        totals.pixels[MT_RECTANGLE] / (f64) frames / 1e3, totals.pixels[MT_CIRCLE] / (f64) frames / 1e3,
+        totals.pixels[MT_TEXTURE] / (f64) frames / 1e3, totals.pixels[MT_FONT] / (f64) frames / 1e3);
+
+    // neither thread waiting means both are working, so that is the time
+    // the drawing of one frame overlapped the building of the next
+    if (state.renderer.thread) {
+        f64 overlap = max(total_time - totals.game_wait_time - totals.render_wait_time, 0.0);
+
+        printf("  render thread (%d packets): %.3f ms/frame drawing, %.3f ms/frame waiting for the game thread\n",
+            FRAME_PACKETS, totals.render_time * 1000.0 / (f64) frames, totals.render_wait_time * 1000.0 / (f64) frames);
+        printf("  game thread %.3f ms/frame waiting for a packet, both threads busy %.1f%% of the run\n",
+            totals.game_wait_time * 1000.0 / (f64) frames, 100.0 * overlap / total_time);
+    } else {
+        printf("  no render thread: %.3f ms/frame drawing on the game thread\n", totals.render_time * 1000.0 / (f64) frames);
+    }
+
+    DebugOverlay *overlay = &state.debug_overlay;
+    printf("  destroyed: %lld collided, %lld shot, %lld spent, %lld out of range, %lld events dropped\n",
+        (long long) overlay->destroyed[DC_COLLIDED], (long long) overlay->destroyed[DC_SHOT], (long long) overlay->destroyed[DC_SPENT],
+        (long long) overlay->destroyed[DC_OUT_OF_RANGE], (long long) destroy_events.dropped.load());
+
+    const char *phase_names[PH_COUNT__] = {
+        "update",
+        "  broadphase",
+        "physics",
+        "draw",
+        "submit",
+    };
+
+    for (i64 i = 0; i < PH_COUNT__; i++) {
+        f64 per = i < PH_DRAW ? (f64) total_ticks : (f64) frames;
+
+        printf("  %-18s %8.4f ms/%s\n", phase_names[i], state.phase_times[i] * 1000.0 / per, i < PH_DRAW ? "tick" : "frame");
+    }
+
+    if (label_count > 0) {
+        bench_labels(label_count, LABEL_BENCH_FRAMES);
+    }
+
+    // the null backend only sees what an instanced draw read
+    if (state.renderer.path == RP_INSTANCED) {
+        ok = check_draw_order(DRAW_ORDER_QUADS);
+    }
+
+    stop_render_thread(&state.renderer, &state.window);
+    shutdown_job_system(&jobs);
+
+    return ok ? 0 : 1;
+}
+
+// argv[index] as a whole number from min to max, value is left as the
+// default when it isn't given
+bool integer_argument(int argc, char **argv, i64 index, i64 min, i64 max, i64 *value) {
+    if (index >= argc) {
+        return true;
+    }
+
+    char *end = nullptr;
+    errno = 0;
+    long long parsed = strtoll(argv[index], &end, 10);
+
+    if (end == argv[index] || *end != 0 || errno == ERANGE || parsed < min || parsed > max) {
+        printf("argument %lld should be a whole number from %lld to %lld, got \"%s\"\n", (long long) index, (long long) min, (long long) max, argv[index]);
+        return false;
+    }
+
+    *value = parsed;
+    return true;
+}
+
+// same for a number that can have a fraction, at least min
+bool number_argument(int argc, char **argv, i64 index, f64 min, f64 *value) {
+    if (index >= argc) {
+        return true;
+    }
+
+    char *end = nullptr;
+    f64 parsed = strtod(argv[index], &end);
+
+    // !(>=) so nan is rejected too
+    if (end == argv[index] || *end != 0 || !(parsed >= min) || isinf(parsed)) {
+        printf("argument %lld should be a number of at least %g, got \"%s\"\n", (long long) index, min, argv[index]);
+        return false;
+    }
+
+    *value = parsed;
+    return true;
+}
+
+// push index of each quad check_draw_order drew, in the order they were drawn
+Slice<u32> drawn_order;
+i64 drawn_count;
+
+void record_instanced_draw(GLsizei instance_count, GLuint base_instance) {
+    Instance *instances = (Instance *) state.renderer.stream.mapped + base_instance;
+
+    for (i64 i = 0; i < instance_count && drawn_count < drawn_order.len; i++) {
+        drawn_order[drawn_count] = instances[i].colour & 0xffffff;
+        drawn_count += 1;
+    }
+}
+
+// one frame of count rectangles, circles and player sprites piled on each
+// other in one layer at the same depth. anything that overlaps has to be
+// drawn in the order it was pushed whichever material it is, the push
+// index is the quad's colour so the draws say what order they came in
+bool check_draw_order(i64 count) {
+    Slice<v4> boxes = mem_alloc<v4>(count); // min x, min y, max x, max y
+    Slice<i64> drawn_at = mem_alloc<i64>(count);
+    drawn_order = mem_alloc<u32>(count);
+    drawn_count = 0;
+
+    RenderStats before = get_total_stats(&state.renderer);
+
+    new_frame(&state.renderer, &state.window, state.camera);
+    next_layer(&state.renderer);
+
+    for (i64 i = 0; i < count; i++) {
+        u32 random = (u32) (i * 2654435761u);
+        v3 position = {(f32) (random % 1000) - 500.0f, (f32) ((random >> 12) % 600) - 300.0f, 0};
+        f32 extent = (f32) (10 + (random >> 24) % 40);
+        v4 colour = {(f32) (i & 0xff) / 255.0f, (f32) ((i >> 8) & 0xff) / 255.0f, (f32) ((i >> 16) & 0xff) / 255.0f, 1};
+
+        if (i % 3 == 0) {
+            draw_rectangle(&state.renderer, position, {extent * 2, extent * 2}, colour);
+        } else if (i % 3 == 1) {
+            draw_circle(&state.renderer, position, extent, colour);
+        } else {
+            draw_texture(&state.renderer, TH_PLAYER, position, {extent * 2, extent * 2}, 0, colour);
+        }
+
+        boxes[i] = {position.X - extent, position.Y - extent, position.X + extent, position.Y + extent};
+        drawn_at[i] = -1;
+    }
+
+    null_gl_on_instanced_draw = record_instanced_draw;
+    draw_frame(&state.renderer, &state.window);
+    wait_for_frames(&state.renderer);
+    null_gl_on_instanced_draw = nullptr;
+
+    for (i64 i = 0; i < drawn_count; i++) {
+        drawn_at[drawn_order[i]] = i;
+    }
+
+    i64 missing = 0;
+    i64 overlapping = 0;
+    i64 out_of_order = 0;
+
+    for (i64 a = 0; a < count; a++) {
+        if (drawn_at[a] < 0) {
+            missing += 1;
+            continue;
+        }
+
+        for (i64 b = a + 1; b < count; b++) {
+            bool overlap = boxes[a].X < boxes[b].Z && boxes[b].X < boxes[a].Z && boxes[a].Y < boxes[b].W && boxes[b].Y < boxes[a].W;
+            if (!overlap || drawn_at[b] < 0) {
+                continue;
+            }
+
+            overlapping += 1;
+            if (drawn_at[b] < drawn_at[a]) {
+                out_of_order += 1;
+            }
+        }
+    }
+
+    RenderStats after = get_total_stats(&state.renderer);
+
+    printf("draw order: %lld quads, %lld draw calls, %lld overlapping pairs, %lld drawn out of push order, %lld not drawn\n",
+        (long long) count, (long long) (after.draw_calls - before.draw_calls), (long long) overlapping, (long long) out_of_order, (long long) missing);
+
+    mem_free(boxes);
+    mem_free(drawn_at);
+    mem_free(drawn_order);
+
+    return out_of_order == 0 && missing == 0;
+}
+
+// floating damage numbers, count of them a frame spread a bit past the
+// edges of the camera. "same" draws the same numbers every frame so the
+// layouts are cached, "new" changes them every frame so most are laid out
+// again. only the calls are timed, not building or drawing the frame
+void bench_labels(i64 count, i64 frames) {
+    Slice<Label> labels = mem_alloc<Label>(count);
+    Slice<u8> text = mem_alloc<u8>(count * 16);
+
+    const char *mode_names[] = {
+        "draw_text each, same numbers",
+        "draw_labels,    same numbers",
+        "draw_labels,    new numbers ",
+        "measure_text,   same numbers",
+    };
+
+    printf("labels: %lld a frame for %lld frames\n", (long long) count, (long long) frames);
+
+    for (i64 mode = 0; mode < 4; mode++) {
+        RenderStats before = get_total_stats(&state.renderer);
+        f64 time = 0;
+        f32 width = 0;
+
+        for (i64 frame = 0; frame < frames; frame++) {
+            new_frame(&state.renderer, &state.window, state.camera);
+            next_layer(&state.renderer);
+
+            for (i64 i = 0; i < count; i++) {
+                u32 random = (u32) (i * 2654435761u);
+                i64 damage = (i * 7919) % 1000 + (mode == 2 ? frame * 1000 : 0);
+
+                i64 length = sprintf((char *) &text[i * 16], "-%lld", (long long) damage);
+
+                labels[i] = {
+                    .text = make_slice(&text[i * 16], length),
+                    .position = {(f32) (random % 1400) - 700.0f, (f32) ((random >> 12) % 1000) - 500.0f, 0},
+                    .font_size = 14,
+                    .colour = RED,
+                };
+            }
+
+            f64 start = time_now();
+
+            if (mode == 0) {
+                for (i64 i = 0; i < count; i++) {
+                    draw_text(&state.renderer, labels[i].text, labels[i].position, labels[i].font_size, labels[i].colour);
+                }
+            } else if (mode == 3) {
+                for (i64 i = 0; i < count; i++) {
+                    width += measure_text(&state.renderer, labels[i].text, labels[i].font_size).X;
+                }
+            } else {
+                draw_labels(&state.renderer, labels);
+            }
+
+            time += time_now() - start;
+
+            draw_frame(&state.renderer, &state.window);
+        }
+
+        wait_for_frames(&state.renderer);
+        RenderStats after = get_total_stats(&state.renderer);
+
+        i64 quads = after.quads - before.quads;
+        i64 culled = after.culled - before.culled;
+        i64 laid_out = after.text_laid_out - before.text_laid_out;
+
+        printf("  %s: %7.1f ns/label, %.3f ms/frame, %.1f glyphs/label, %.1f%% laid out",
+            mode_names[mode], time * 1e9 / (f64) (count * frames), time * 1000.0 / (f64) frames,
+            (f64) (quads + culled) / (f64) (count * frames), 100.0 * (f64) laid_out / (f64) (count * frames));
+        if (mode == 3) {
+            printf(", %.1f average width", width / (f32) (count * frames));
+        }
+        printf("\n");
+    }
+
+    mem_free(labels);
+    mem_free(text);
+}
@@ -1,4 +1,4 @@
-#include "libs/libs.h"
+#include "backend.h"
 #include "game.h"
 
 #include <time.h>
@@ -7,7 +7,22 @@
 // Total: 22:30
 // started: 16:00
 
+// headless.cpp raises this to stress the game with way more entities
+#ifndef MAX_ENTITIES
 #define MAX_ENTITIES 2000
+#endif
+
+// the simulation always steps by SIMULATION_DELTA_TIME, rendering just
+// draws wherever it is between the last two ticks. missles are swept so
+// this can go down without them skipping through asteroids
+#ifndef SIMULATION_RATE
+#define SIMULATION_RATE 60
+#endif
+#define SIMULATION_DELTA_TIME (1.0f / SIMULATION_RATE)
+#define MAX_FRAME_TIME 0.25
+
+// how many entities a job in update gets at least
+#define UPDATE_JOB_GRAIN 256
 
 #define PLAYER_SPEED 0.7
 #define PLAYER_MAX_SPEED 300
@@ -21,12 +36,14 @@
 #define ASTEROID_SPAWN_OFFSET 200
 #define ASTEROID_SPEED 200
 
+// what gets passed to spawn_entity, the entity itself is split across
+// the arrays in EntityStore once it is spawned
 struct Entity {
     // meta
     u64 flags;
 
     // entity
-    v3 position;
+    v2 position;
     v2 size;
     f32 rotation;
     v2 velocity;
@@ -35,13 +52,66 @@ struct Entity {
     TextureHandle texture;
 };
 
+// the parts of an entity only the draw path uses
+struct EntityRenderData {
+    TextureHandle texture;
+};
+
+enum DestroyCause {
+    DC_COLLIDED,        // player and asteroid ran into each other
+    DC_SHOT,            // asteroid hit by a missle
+    DC_SPENT,           // missle that hit something
+    DC_OUT_OF_RANGE,
+    DC_COUNT__
+};
+
+// pushed by destroy_entity, the handle has already stopped resolving by
+// the time anything reads it so it is only good as an id
+struct DestroyEvent {
+    EntityHandle entity;
+    DestroyCause cause;
+    u64 tick;
+};
+
+// what the debug overlay keeps from the events it drains
+struct DebugOverlay {
+    bool visible;
+    bool entity_ids; // each entity's slot drawn over it, f2
+
+    Array<i64, DC_COUNT__> destroyed;
+    Array<DestroyEvent, 8> recent;
+    i64 recent_next;
+};
+
+// what a fast entity runs into this tick, worked out in parallel and
+// acted on after
+struct FastHit {
+    i64 other;
+    f32 time;
+    i64 pair_tests;
+};
+
+// where a frame goes, filled in by begin_phase/end_phase and read by
+// headless.cpp. update includes the broadphase
+enum Phase {
+    PH_UPDATE,
+    PH_BROADPHASE,
+    PH_PHYSICS,
+    PH_DRAW,
+    PH_SUBMIT,
+    PH_COUNT__
+};
+
 enum EntityFlags {
     EF_PLAYER   = 1 << 0,
     EF_ASTEROID = 1 << 1,
     EF_MISSLE   = 1 << 2,
     EF_DELETE   = 1 << 3,
+    EF_FAST     = 1 << 4, // collides over its whole motion each tick, see update
 };
 
+#define ENTITY_LABEL_LENGTH 12
+
 struct State {
     Camera camera;
     Window window;
@@ -49,34 +119,183 @@ struct State {
     SoundEngine sound_engine;
 
     f64 time;
+    f64 accumulator;
+    f32 time_scale;
+    u64 tick;
+
+    Array<f64, PH_COUNT__> phase_times;
+    Array<f64, PH_COUNT__> phase_starts;
 
     f32 spawn_timer;
+    f32 asteroid_spawn_rate;
+    i64 asteroids_per_spawn;
     i64 score;
-    Array<Entity, MAX_ENTITIES> entities;
+    EntityHandle player;
+    DebugOverlay debug_overlay;
+    EntityStore<EntityRenderData, MAX_ENTITIES> entities;
+
+    // asteroids are the only thing collided against, the grid is for
+    // slow entities and the sweep list is for EF_FAST ones
+    SpatialGrid<MAX_ENTITIES> asteroid_grid;
+    SweepList<MAX_ENTITIES> asteroid_sweep;
+
+    // one per entry in the EF_FAST bucket
+    FastHit fast_hits[MAX_ENTITIES];
+
+    // how many aabb tests the narrow phase did, headless.cpp reports it
+    i64 pair_tests;
+
+    // DebugOverlay.entity_ids, one label a entity and the text they point into
+    Label entity_labels[MAX_ENTITIES];
+    u8 entity_label_text[MAX_ENTITIES * ENTITY_LABEL_LENGTH];
 } state = {};
 
+// 0 is one thread per core, headless.cpp sets it to measure scaling
+i64 job_thread_count = 0;
+RenderPath render_path = RP_INSTANCED;
+VertexFormat vertex_format = VF_FLOATS;
+FontMode font_mode = FM_SDF;
+bool render_thread = true;
+JobSystem jobs = {};
+
+// font_bake.cpp bakes blobs of these next to the game
+#define FONT_PATH "resources/fonts/LibreBaskerville.ttf"
+
+FontSettings game_font_settings(FontMode mode) {
+    if (mode == FM_SDF) {
+        return {.mode = FM_SDF, .pixel_height = 48, .padding = 4, .width = 512, .height = 512};
+    }
+
+    return {.mode = FM_BAKED, .pixel_height = 160, .padding = 0, .width = 1000, .height = 1000};
+}
+
+const char *font_blob_path(FontMode mode) {
+    return mode == FM_SDF ? "build/LibreBaskerville_sdf.font" : "build/LibreBaskerville_baked.font";
+}
+
+// outside of state because atomics cant be copied and state gets
+// assigned in init. the simulation pushes and the debug overlay or
+// headless.cpp drains, nothing in the tick ever prints
+RingBuffer<DestroyEvent, 4096> destroy_events = {};
+
+// iterators count their own pair tests so they can run on any thread
 struct CollisionIterator {
-    Entity* entity;
-    i64 index;
+    i64 entity;
+    SpatialGrid<MAX_ENTITIES> *grid;
+    GridQuery query;
+    i64 pair_tests;
+};
+
+struct SweepIterator {
+    i64 entity;
+    f32 delta_time;
+    SweepList<MAX_ENTITIES> *list;
+    SweepQuery query;
+    i64 pair_tests;
 };
 
+bool init();
 void input();
-void update_and_draw(f32 delta_time);
+void consume_key_presses();
+void consume_key_press(i32 key);
+bool consume_frame_key(i32 key);
+void tick();
+void update(f32 delta_time);
 void physics(f32 delta_time);
+void steer_asteroids(void *data, i64 start, i64 end);
+void find_fast_hits(void *data, i64 start, i64 end);
+FastHit find_first_hit(i64 entity, f32 delta_time);
+void draw(f32 alpha);
+void drain_destroy_events();
+void draw_debug_overlay();
+void draw_entity_ids(f32 alpha);
+void begin_phase(Phase phase);
+void end_phase(Phase phase);
+
+EntityHandle spawn_entity(Entity entity);
+EntityHandle spawn_player();
+void destroy_entity(i64 index, DestroyCause cause);
+
+CollisionIterator new_collision_iterator(i64 entity, SpatialGrid<MAX_ENTITIES> *grid);
+i64 next(CollisionIterator *iterator);
+
+SweepIterator new_sweep_iterator(i64 entity, SweepList<MAX_ENTITIES> *list, f32 delta_time);
+i64 next(SweepIterator *iterator, f32 *hit_time);
+
+#ifndef HEADLESS
+int main() {
+    bool ok = init();
+    if (!ok) {
+        return 1;
+    }
 
-void spawn_entity(Entity entity);
+    while (!glfwWindowShouldClose(state.window.glfw_window)) {
+        f64 current_time    = state.time;
+        f64 new_time        = glfwGetTime();
+        f64 frame_time      = new_time - current_time;
+        state.time          = new_time;
 
-CollisionIterator new_collision_iterator(Entity *entity);
-Entity *next(CollisionIterator *iterator);
+        input();
 
-int main() {
+        if (KEYS[GLFW_KEY_ESCAPE] == InputState::down) {
+            glfwSetWindowShouldClose(state.window.glfw_window, GLFW_TRUE);
+        }
+
+        if (consume_frame_key(GLFW_KEY_F1)) {
+            state.debug_overlay.visible = !state.debug_overlay.visible;
+        }
+
+        if (consume_frame_key(GLFW_KEY_F2)) {
+            state.debug_overlay.entity_ids = !state.debug_overlay.entity_ids;
+        }
+
+        { // fixed step simulation
+            // a long hitch (debugger, window drag) would otherwise queue up
+            // so many ticks that we never catch back up
+            if (frame_time > MAX_FRAME_TIME) {
+                frame_time = MAX_FRAME_TIME;
+            }
+
+            // time_scale above 1 runs more ticks per frame than real time
+            state.accumulator += frame_time * state.time_scale;
+
+            while (state.accumulator >= SIMULATION_DELTA_TIME) {
+                tick();
+                state.accumulator -= SIMULATION_DELTA_TIME;
+            }
+        }
+
+        drain_destroy_events();
+
+        begin_phase(PH_DRAW);
+        new_frame(&state.renderer, &state.window, state.camera);
+        draw((f32) (state.accumulator / SIMULATION_DELTA_TIME));
+        end_phase(PH_DRAW);
+
+        begin_phase(PH_SUBMIT);
+        draw_frame(&state.renderer, &state.window);
+        end_phase(PH_SUBMIT);
+    }
+
+    stop_render_thread(&state.renderer, &state.window);
+    shutdown_job_system(&jobs);
+    glfwTerminate();
+
+    return 0;
+}
+#endif
+
+bool init() {
     state = {
         .camera = {
             .position = {0, 0, -1},
             .orthographic_size = 450,
             .near_plane = 0.1f,
             .far_plane = 100.0f,
-        }
+        },
+        .time_scale = 1.0f,
+        .asteroid_spawn_rate = ASTEROID_SPAWN_RATE,
+        .asteroids_per_spawn = 1,
     };
 
     { // init engine stuff
@@ -85,48 +304,69 @@ int main() {
         ok = init_window(&state.window, 1440, 1080, "game6");
         if (!ok) {
             printf("failed to init window\n");
-            return 1;
+            return false;
         }
     
-        ok = init_renderer(&state.renderer, &state.window);
+        ok = init_renderer(&state.renderer, &state.window, render_path, vertex_format, font_mode, render_thread);
         if (!ok) {
             printf("failed to init the renderer\n");
-            return 1;
+            return false;
         }
 
         ok = load_textures(&state.renderer);
         if (!ok) {
             printf("failed to load textures\n");
-            return 1;
+            return false;
         }
 
-        ok = load_font(&state.renderer, "resources/fonts/LibreBaskerville.ttf", 1000, 1000, 160);
+        // baking from the ttf takes longer than everything else here
+        FontSettings settings = game_font_settings(font_mode);
+        ok = load_font_blob(&state.renderer, font_blob_path(font_mode), settings);
         if (!ok) {
-            printf("failed to load textures\n");
-            return 1;
+            ok = load_font(&state.renderer, FONT_PATH, settings);
+        }
+        if (!ok) {
+            printf("failed to load the font\n");
+            return false;
+        }
+
+        // textures and the font are uploaded, nothing else here needs gl
+        ok = start_render_thread(&state.renderer, &state.window);
+        if (!ok) {
+            printf("failed to start the render thread\n");
+            return false;
         }
 
         ok = init_sound_engine(&state.sound_engine);
         if (!ok) {
             printf("failed to init sound engine\n");
-            return 1;
+            return false;
         }
 
         ok = load_sounds(&state.sound_engine);
         if (!ok) {
             printf("failed to load sounds\n");
-            return 1;
+            return false;
+        }
+
+        i64 thread_count = job_thread_count > 0 ? job_thread_count : min(hardware_thread_count(), (i64) MAX_JOB_THREADS);
+
+        ok = init_job_system(&jobs, thread_count);
+        if (!ok) {
+            printf("failed to init job system\n");
+            return false;
         }
 
         srand(time(NULL));
     }
 
     { // init game stuff
-        spawn_entity(Entity {
-            .flags = EF_PLAYER,
-            .size = {50, 50},
-            .texture = TH_PLAYER,
-        });
+        track_flag(&state.entities, (u64) EF_PLAYER);
+        track_flag(&state.entities, (u64) EF_ASTEROID);
+        track_flag(&state.entities, (u64) EF_MISSLE);
+        track_flag(&state.entities, (u64) EF_FAST);
+
+        spawn_player();
 
         // spawn_entity(Entity {
             // .flags = EF_ASTEROID,
@@ -136,29 +376,7 @@ int main() {
         // });
     }
 
-    while (!glfwWindowShouldClose(state.window.glfw_window)) {
-        f64 current_time    = state.time;
-        f64 new_time        = glfwGetTime();
-        f32 delta_time      = (f32) (new_time - current_time);
-        state.time          = new_time;
-
-        input();
-
-        if (KEYS[GLFW_KEY_ESCAPE] == InputState::down) {
-            glfwSetWindowShouldClose(state.window.glfw_window, GLFW_TRUE);
-        }
-
-        new_frame(&state.renderer, &state.window, state.camera);
-
-        update_and_draw(delta_time);
-        physics(delta_time);
-
-        draw_frame(&state.renderer, &state.window);
-    }
-
-    glfwTerminate();
-
-    return 0;
+    return true;
 }
 
 void input() {
@@ -172,191 +390,508 @@ void input() {
     //
     // copied from odin engine so maybe need to look into this more
     // - 03/03/25
-    
+    //
+    // the down -> pressed part moved to consume_key_presses after each
+    // tick, with a fixed step there can be zero or many ticks a frame and
+    // a press has to be seen by exactly one of them - 16/10/26
+
+    glfwPollEvents();
+}
+
+void consume_key_presses() {
     for (int i = 0; i < KEYS.size; i++) {
         if (KEYS[i] == InputState::down) {
-            KEYS[i] = InputState::pressed;
+            consume_key_press(i);
         }
     }
+}
 
-    glfwPollEvents();
+// down has been seen, held keys go to pressed and ones already let go
+// go up
+void consume_key_press(i32 key) {
+    KEYS[key] = KEYS_RELEASED[key] ? InputState::up : InputState::pressed;
+    KEYS_RELEASED[key] = false;
+}
+
+// for keys handled once a frame outside of tick, like the debug toggles.
+// consume_key_presses only runs after a tick and frames can have none, so
+// without this a press stays down and is seen again the next frame
+bool consume_frame_key(i32 key) {
+    if (KEYS[key] != InputState::down) {
+        return false;
+    }
+
+    consume_key_press(key);
+    return true;
+}
+
+// one fixed step of the simulation
+void tick() {
+    store_previous_state(&state.entities);
+
+    begin_phase(PH_UPDATE);
+    update(SIMULATION_DELTA_TIME);
+    end_phase(PH_UPDATE);
+
+    begin_phase(PH_PHYSICS);
+    physics(SIMULATION_DELTA_TIME);
+    end_phase(PH_PHYSICS);
+
+    consume_key_presses();
+
+    state.tick += 1;
 }
 
-void update_and_draw(f32 delta_time) {
+void update(f32 delta_time) {
 
     { // asteroid spawning
         state.spawn_timer -= delta_time;
 
         if (state.spawn_timer <= 0) {
-            state.spawn_timer = ASTEROID_SPAWN_RATE;
-
-            v2 direction = vector_from_angle(rand_f32() * 360);
-            v2 velocity = -(direction * ASTEROID_SPEED);
-            v2 position_offset = v2{ASTEROID_SPAWN_OFFSET * rand_f32_negative(), ASTEROID_SPAWN_OFFSET * rand_f32_negative()};
-            v2 position = (direction * ASTEROID_SPAWN_DISTANCE) + position_offset;
-
-            spawn_entity(Entity {
-                .flags = EF_ASTEROID,
-                .position = v3 {
-                    position.X,
-                    position.Y, 
-                    0
-                },
-                .size = v2{60, 60},
-                .velocity = velocity,
-                .texture = TH_MISSLE,
-            });
+            state.spawn_timer = state.asteroid_spawn_rate;
+
+            for (i64 spawned = 0; spawned < state.asteroids_per_spawn; spawned++) {
+                v2 direction = vector_from_angle(rand_f32() * 360);
+                v2 velocity = -(direction * ASTEROID_SPEED);
+                v2 position_offset = v2{ASTEROID_SPAWN_OFFSET * rand_f32_negative(), ASTEROID_SPAWN_OFFSET * rand_f32_negative()};
+                v2 position = (direction * ASTEROID_SPAWN_DISTANCE) + position_offset;
+
+                spawn_entity(Entity {
+                    .flags = EF_ASTEROID,
+                    .position = position,
+                    .size = v2{60, 60},
+                    .velocity = velocity,
+                    .texture = TH_MISSLE,
+                });
+            }
         }
     }
 
-    for (int i = 0; i < state.entities.len; i++) {
-        Entity* entity = &state.entities[i];
+    // entities spawned after this wont be in the grids until next frame
+    begin_phase(PH_BROADPHASE);
+    {
+        EntityStore<EntityRenderData, MAX_ENTITIES> *entities = &state.entities;
+        Slice<u32> asteroids = entities_with_flag(entities, (u64) EF_ASTEROID);
 
-        { // player
-            if (entity->flags & EF_PLAYER) {
-                if (KEYS[GLFW_KEY_W] == InputState::pressed) {
-                    v2 direction = vector_from_angle(entity->rotation);
+        i32 axis = sweep_axis(entities->velocities, entities_with_flag(entities, (u64) EF_FAST));
 
-                    entity->velocity.X += direction.X * PLAYER_SPEED;
-                    entity->velocity.Y += direction.Y * PLAYER_SPEED;
+        build_spatial_grid(&state.asteroid_grid, entities->positions, entities->sizes, asteroids);
+        build_sweep_list(&state.asteroid_sweep, axis, entities->positions, entities->sizes, entities->velocities, delta_time, asteroids);
+    }
+    end_phase(PH_BROADPHASE);
 
-                    if (length(entity->velocity) > PLAYER_MAX_SPEED) {
-                        entity->velocity = norm(entity->velocity);
+    { // player
+        Slice<u32> players = entities_with_flag(&state.entities, (u64) EF_PLAYER);
 
-                        entity->velocity.X += direction.X * PLAYER_MAX_SPEED;
-                        entity->velocity.Y += direction.Y * PLAYER_MAX_SPEED;
-                    }
-                }
-    
-                if (KEYS[GLFW_KEY_A] == InputState::pressed) {
-                    entity->rotation -= PLAYER_ROTATION_SPEED;
-                }
+        for (i64 i = 0; i < players.len; i++) {
+            EntityRef<EntityRenderData> entity = get_entity(&state.entities, players[i]);
 
-                if (KEYS[GLFW_KEY_D] == InputState::pressed) {
-                    entity->rotation += PLAYER_ROTATION_SPEED;
-                }
+            if (KEYS[GLFW_KEY_W] == InputState::pressed) {
+                v2 direction = vector_from_angle(entity.rotation);
 
-                if (KEYS[GLFW_KEY_SPACE] == InputState::down) {
-                    v2 direction = vector_from_angle(entity->rotation);
+                entity.velocity.X += direction.X * PLAYER_SPEED;
+                entity.velocity.Y += direction.Y * PLAYER_SPEED;
 
-                    spawn_entity(Entity {
-                        .flags = EF_MISSLE,
-                        .position = entity->position,
-                        .size = {10, 10},
-                        .velocity = direction * MISSLE_SPEED,
-                        .texture = TH_MISSLE,
-                    });
+                if (length(entity.velocity) > PLAYER_MAX_SPEED) {
+                    entity.velocity = norm(entity.velocity);
 
-                    play_sound(&state.sound_engine, SH_DASH);
+                    entity.velocity.X += direction.X * PLAYER_MAX_SPEED;
+                    entity.velocity.Y += direction.Y * PLAYER_MAX_SPEED;
                 }
+            }
+
+            if (KEYS[GLFW_KEY_A] == InputState::pressed) {
+                entity.rotation -= PLAYER_ROTATION_SPEED;
+            }
+
+            if (KEYS[GLFW_KEY_D] == InputState::pressed) {
+                entity.rotation += PLAYER_ROTATION_SPEED;
+            }
 
-                // asteroid collision
-                CollisionIterator iter = new_collision_iterator(entity);
-                while (true) {
-                    Entity *other = next(&iter);
-                    if (other == nullptr) {
-                        break;
-                    }
-
-                    if (other->flags & EF_ASTEROID) {
-                        entity->flags |= EF_DELETE;
-                        other->flags |= EF_DELETE;
-                    }
+            if (KEYS[GLFW_KEY_SPACE] == InputState::down) {
+                v2 direction = vector_from_angle(entity.rotation);
+
+                spawn_entity(Entity {
+                    .flags = EF_MISSLE | EF_FAST,
+                    .position = entity.position,
+                    .size = {10, 10},
+                    .velocity = direction * MISSLE_SPEED,
+                    .texture = TH_MISSLE,
+                });
+
+                play_sound(&state.sound_engine, SH_DASH);
+            }
+
+            // asteroid collision
+            CollisionIterator iter = new_collision_iterator(entity.index, &state.asteroid_grid);
+            while (true) {
+                i64 other = next(&iter);
+                if (other < 0) {
+                    break;
                 }
+
+                destroy_entity(entity.index, DC_COLLIDED);
+                destroy_entity(other, DC_COLLIDED);
             }
+
+            state.pair_tests += iter.pair_tests;
         }
+    }
 
-        { // asteroid
-            if (entity->flags & EF_ASTEROID) {
-                entity->rotation += 0.15;
+    // the rest is split in two, first everything that only reads the
+    // world and writes to its own entity or its own result runs across
+    // the job threads, then anything that changes the world (destroying,
+    // spawning, score) is applied on this thread in entity order so the
+    // result is the same no matter how many threads there are
 
-                CollisionIterator iter = new_collision_iterator(entity);
-                while (true) {
-                    Entity *other = next(&iter);
-                    if (other == nullptr) {
-                        break;
-                    }
+    Slice<u32> asteroids = entities_with_flag(&state.entities, (u64) EF_ASTEROID);
+    Slice<u32> fast = entities_with_flag(&state.entities, (u64) EF_FAST);
 
-                    if (other->flags & EF_MISSLE) {
-                        entity->flags |= EF_DELETE;
-                        other->flags |= EF_DELETE;
+    { // parallel
+        parallel_for(&jobs, asteroids.len, UPDATE_JOB_GRAIN, steer_asteroids, &asteroids);
+        parallel_for(&jobs, fast.len, UPDATE_JOB_GRAIN, find_fast_hits, &delta_time);
+    }
 
-                        state.score += 1;
-                    }
-                }
+    { // fast entities
+        for (i64 i = 0; i < fast.len; i++) {
+            EntityRef<EntityRenderData> entity = get_entity(&state.entities, fast[i]);
+            FastHit hit = state.fast_hits[i];
+
+            state.pair_tests += hit.pair_tests;
+
+            // an earlier one already took out what this one was going to
+            // hit, look again now that it is gone
+            if (hit.other >= 0 && (state.entities.flags[hit.other] & EF_DELETE)) {
+                hit = find_first_hit(entity.index, delta_time);
+                state.pair_tests += hit.pair_tests;
+            }
+
+            if (hit.other >= 0 && (entity.flags & EF_MISSLE)) {
+                destroy_entity(entity.index, DC_SPENT);
+                destroy_entity(hit.other, DC_SHOT);
+
+                state.score += 1;
             }
         }
+    }
 
-        { // missle
-            if (entity->flags & EF_MISSLE) {
-                if (length(entity->position.XY) >= MISSLE_DESPAWN_DISTANCE) {
-                    entity->flags |= EF_DELETE;
-                }
+    { // missle
+        Slice<u32> missles = entities_with_flag(&state.entities, (u64) EF_MISSLE);
+
+        for (i64 i = 0; i < missles.len; i++) {
+            EntityRef<EntityRenderData> entity = get_entity(&state.entities, missles[i]);
+
+            if (length(entity.position) >= MISSLE_DESPAWN_DISTANCE) {
+                destroy_entity(entity.index, DC_OUT_OF_RANGE);
             }
         }
+    }
+
+    // everything destroyed this tick goes in one pass
+    compact_entities(&state.entities, (u64) EF_DELETE);
+}
+
+// job, data is the asteroid bucket
+void steer_asteroids(void *data, i64 start, i64 end) {
+    Slice<u32> asteroids = *(Slice<u32> *) data;
 
-        draw_texture(&state.renderer, entity->texture, entity->position, entity->size, entity->rotation, WHITE);
+    for (i64 i = start; i < end; i++) {
+        state.entities.rotations[asteroids[i]] += 0.15;
+    }
+}
+
+// job, data is the delta time. fills in state.fast_hits
+void find_fast_hits(void *data, i64 start, i64 end) {
+    f32 delta_time = *(f32 *) data;
+    Slice<u32> fast = entities_with_flag(&state.entities, (u64) EF_FAST);
+
+    for (i64 i = start; i < end; i++) {
+        state.fast_hits[i] = find_first_hit(fast[i], delta_time);
+    }
+}
+
+// missles move further than they are big in a long enough tick, so they
+// are checked against where the asteroids are over the whole tick instead
+// of just where they are now. the first asteroid hit is the one that
+// stops it
+FastHit find_first_hit(i64 entity, f32 delta_time) {
+    FastHit hit = {
+        .other = -1,
+        .time = 2,
+    };
+
+    SweepIterator iter = new_sweep_iterator(entity, &state.asteroid_sweep, delta_time);
+    while (true) {
+        f32 hit_time = 0;
+
+        i64 other = next(&iter, &hit_time);
+        if (other < 0) {
+            break;
+        }
+
+        // already destroyed this tick
+        if (state.entities.flags[other] & EF_DELETE) {
+            continue;
+        }
+
+        if (hit_time < hit.time) {
+            hit.other = other;
+            hit.time = hit_time;
+        }
     }
 
+    hit.pair_tests = iter.pair_tests;
+    return hit;
+}
+
+void physics(f32 delta_time) {
+    integrate_positions(state.entities.positions, state.entities.velocities, state.entities.len, delta_time);
+}
+
+// alpha is how far we are from the last tick to the next one, 0 -> 1
+void draw(f32 alpha) {
+    EntityStore<EntityRenderData, MAX_ENTITIES> *entities = &state.entities;
+
+    for (int i = 0; i < entities->len; i++) {
+        v2 position = HMM_LerpV2(entities->previous_positions[i], alpha, entities->positions[i]);
+        f32 rotation = HMM_Lerp(entities->previous_rotations[i], alpha, entities->rotations[i]);
+
+        draw_texture(&state.renderer, entities->cold[i].texture, v3{position.X, position.Y, 0}, entities->sizes[i], rotation, WHITE);
+    }
+
+    // text goes over the entities
+    next_layer(&state.renderer);
+
     { // score
         u8 buffer[100];
-        i64 length = sprintf((char *) buffer, "score: %lld", state.score);
+        i64 length = sprintf((char *) buffer, "score: %lld", (long long) state.score);
 
         string text = make_slice(buffer, length);
 
         draw_text(&state.renderer, text, {-580, 420, 0}, 20, WHITE);
     }
 
-    for (int i = 0; i < state.entities.len; i++) {
-        Entity* entity = &state.entities[i];
+    if (state.debug_overlay.entity_ids) {
+        draw_entity_ids(alpha);
+    }
 
-        if (entity->flags & EF_DELETE) {
-            swap_remove(&state.entities, i);
-            i--;
+    if (state.debug_overlay.visible) {
+        draw_debug_overlay();
+    }
+}
 
-            printf("entity deleted\n");
-        }
+// thousands of labels a frame in a storm so they go through draw_labels
+void draw_entity_ids(f32 alpha) {
+    EntityStore<EntityRenderData, MAX_ENTITIES> *entities = &state.entities;
+
+    for (i64 i = 0; i < entities->len; i++) {
+        v2 position = HMM_LerpV2(entities->previous_positions[i], alpha, entities->positions[i]);
+        u8 *text = &state.entity_label_text[i * ENTITY_LABEL_LENGTH];
+
+        i64 length = snprintf((char *) text, ENTITY_LABEL_LENGTH, "%u", entities->index_slots[i]);
+
+        // centred just over the top of the entity
+        v2 size = measure_text(&state.renderer, make_slice(text, length), 10);
+
+        state.entity_labels[i] = {
+            .text = make_slice(text, length),
+            .position = {position.X - size.X * 0.5f, position.Y + entities->sizes[i].Y * 0.5f + 2, 0},
+            .font_size = 10,
+            .colour = GREEN,
+        };
     }
+
+    draw_labels(&state.renderer, make_slice(state.entity_labels, entities->len));
 }
 
-void physics(f32 delta_time) {
-    for (int i = 0; i < state.entities.len; i++) {
-        Entity* entity = &state.entities[i];
+// moves everything out of destroy_events into the overlay, once a frame
+void drain_destroy_events() {
+    DebugOverlay *overlay = &state.debug_overlay;
+
+    DestroyEvent event = {};
+    while (ring_pop(&destroy_events, &event)) {
+        overlay->destroyed[event.cause] += 1;
+
+        overlay->recent[overlay->recent_next % overlay->recent.size] = event;
+        overlay->recent_next += 1;
+    }
+}
+
+void draw_debug_overlay() {
+    DebugOverlay *overlay = &state.debug_overlay;
+
+    const char *cause_names[DC_COUNT__] = {
+        "collided",
+        "shot",
+        "spent",
+        "out of range",
+    };
+
+    u8 buffer[100];
+    f32 y = 390;
+
+    { // totals
+        i64 length = sprintf((char *) buffer, "collided %lld  shot %lld  spent %lld  out of range %lld  dropped %lld",
+            (long long) overlay->destroyed[DC_COLLIDED], (long long) overlay->destroyed[DC_SHOT], (long long) overlay->destroyed[DC_SPENT],
+            (long long) overlay->destroyed[DC_OUT_OF_RANGE], (long long) destroy_events.dropped.load(std::memory_order_relaxed));
 
-        entity->position.X += entity->velocity.X * delta_time;
-        entity->position.Y += entity->velocity.Y * delta_time;
+        draw_text(&state.renderer, make_slice(buffer, length), {-580, y, 0}, 14, GREEN);
+        y -= 22;
+    }
+
+    { // last frame's batches and times the renderer had to wait for the gpu to finish with a stream region
+        RenderStats frame_stats = get_frame_stats(&state.renderer);
+        RenderStats *stats = &frame_stats;
+
+        i64 length = sprintf((char *) buffer, "quads %lld  batches %lld  draw calls %lld  stream waits %lld  %.2f ms",
+            (long long) stats->quads, (long long) stats->batches, (long long) stats->draw_calls, (long long) stats->stream_waits,
+            stats->stream_wait_time * 1000.0);
+
+        draw_text(&state.renderer, make_slice(buffer, length), {-580, y, 0}, 14, GREEN);
+        y -= 22;
+
+        length = sprintf((char *) buffer, "culled %lld  layers %lld  program switches %lld  material runs %lld  order flushes %lld",
+            (long long) stats->culled, (long long) stats->layers, (long long) stats->program_switches, (long long) stats->push_runs,
+            (long long) stats->order_flushes);
+
+        draw_text(&state.renderer, make_slice(buffer, length), {-580, y, 0}, 14, GREEN);
+        y -= 22;
+
+        length = sprintf((char *) buffer, "render %.2f ms  render thread waited %.2f ms  game thread waited %.2f ms",
+            stats->render_time * 1000.0, stats->render_wait_time * 1000.0, stats->game_wait_time * 1000.0);
+
+        draw_text(&state.renderer, make_slice(buffer, length), {-580, y, 0}, 14, GREEN);
+        y -= 22;
+    }
+
+    // newest first
+    i64 count = min(overlay->recent_next, overlay->recent.size);
+    for (i64 i = 0; i < count; i++) {
+        DestroyEvent *event = &overlay->recent[(overlay->recent_next - 1 - i) % overlay->recent.size];
+
+        i64 length = sprintf((char *) buffer, "tick %llu  entity %u:%u  %s",
+            (unsigned long long) event->tick, event->entity.slot, event->entity.generation, cause_names[event->cause]);
+
+        draw_text(&state.renderer, make_slice(buffer, length), {-580, y, 0}, 14, GREEN);
+        y -= 22;
     }
 }
 
-void spawn_entity(Entity entity) {
-    append(&state.entities, entity);
+void begin_phase(Phase phase) {
+    state.phase_starts[phase] = time_now();
 }
 
-CollisionIterator new_collision_iterator(Entity *entity) {
+void end_phase(Phase phase) {
+    state.phase_times[phase] += time_now() - state.phase_starts[phase];
+}
+
+// returns a null handle when the store is full, nothing gets spawned
+EntityHandle spawn_entity(Entity entity) {
+    if (state.entities.len >= MAX_ENTITIES) {
+        return {};
+    }
+
+    EntityRenderData render_data = {
+        .texture = entity.texture,
+    };
+
+    return add_entity(&state.entities, entity.flags, entity.position, entity.size, entity.rotation, entity.velocity, render_data);
+}
+
+EntityHandle spawn_player() {
+    state.player = spawn_entity(Entity {
+        .flags = EF_PLAYER,
+        .size = {50, 50},
+        .texture = TH_PLAYER,
+    });
+
+    return state.player;
+}
+
+// marks the entity to be removed at the end of the tick and records why,
+// anything already marked is left alone so it only gets one event
+void destroy_entity(i64 index, DestroyCause cause) {
+    u64 *flags = &state.entities.flags[index];
+    if (*flags & EF_DELETE) {
+        return;
+    }
+
+    *flags |= EF_DELETE;
+
+    ring_push(&destroy_events, DestroyEvent {
+        .entity = entity_handle(&state.entities, index),
+        .cause = cause,
+        .tick = state.tick,
+    });
+}
+
+// iterates whatever in grid overlaps entity, entity doesnt need to be in it
+CollisionIterator new_collision_iterator(i64 entity, SpatialGrid<MAX_ENTITIES> *grid) {
     return CollisionIterator {
         .entity = entity,
-        .index = 0,
+        .grid = grid,
+        .query = new_grid_query(grid, state.entities.positions[entity], state.entities.sizes[entity]),
     };
 }
 
-Entity *next(CollisionIterator *iterator) {
-    while (iterator->index < state.entities.len) {
-        Entity *entity = iterator->entity;
-        Entity *other = &state.entities[iterator->index];
+// iterates whatever in list touches entity at some point this tick
+SweepIterator new_sweep_iterator(i64 entity, SweepList<MAX_ENTITIES> *list, f32 delta_time) {
+    v2 motion = state.entities.velocities[entity] * delta_time;
 
-        iterator->index++;
+    return SweepIterator {
+        .entity = entity,
+        .delta_time = delta_time,
+        .list = list,
+        .query = new_sweep_query(list, state.entities.positions[entity], state.entities.sizes[entity], motion),
+    };
+}
+
+// returns the index of the next entity iterator->entity runs into this
+// tick or -1, hit_time is how far through the tick they first touch
+i64 next(SweepIterator *iterator, f32 *hit_time) {
+    v2 *positions = state.entities.positions;
+    v2 *velocities = state.entities.velocities;
+    v2 *sizes = state.entities.sizes;
+
+    while (true) {
+        i64 other = next_candidate(iterator->list, &iterator->query);
+        if (other < 0) {
+            break;
+        }
 
-        { // basic aabb collision
-            v2 distance = other->position.XY - entity->position.XY;
-            v2 distance_abs = v2{abs(distance.X), abs(distance.Y)};
-            v2 distance_for_collision = (entity->size + other->size) * v2{0.5, 0.5};
+        i64 entity = iterator->entity;
+        iterator->pair_tests += 1;
 
-            bool collision = distance_for_collision[0] >= distance_abs[0] && distance_for_collision[1] >= distance_abs[1];
-            if (collision) {
-                return other;
-            }
+        v2 motion = velocities[entity] * iterator->delta_time;
+        v2 other_motion = velocities[other] * iterator->delta_time;
+
+        if (swept_aabb_overlap(positions[entity], sizes[entity], motion, positions[other], sizes[other], other_motion, hit_time)) {
+            return other;
+        }
+    }
+
+    return -1;
+}
+
+// returns the index of the next entity overlapping iterator->entity or -1
+i64 next(CollisionIterator *iterator) {
+    v2 *positions = state.entities.positions;
+    v2 *sizes = state.entities.sizes;
+
+    while (true) {
+        i64 other = next_candidate(iterator->grid, &iterator->query);
+        if (other < 0) {
+            break;
+        }
+
+        i64 entity = iterator->entity;
+        iterator->pair_tests += 1;
+
+        // basic aabb collision
+        if (aabb_overlap(positions[entity], sizes[entity], positions[other], sizes[other])) {
+            return other;
         }
     }
 
-    return nullptr;
+    return -1;
 }
@@ -0,0 +1,468 @@
+#ifndef QUAD_CPP
+#define QUAD_CPP
+
+#include "hmm.cpp"
+#include "common.cpp"
+
+#ifdef __AVX__
+#include <immintrin.h>
+#endif
+
+// hmm.cpp only pulls in sse, pack_positions needs the sse2 integer side
+#ifdef HANDMADE_MATH__USE_SSE
+#include <emmintrin.h>
+#endif
+
+// the cpu side of the RP_VERTICES path, turning a position, size and
+// rotation into the 4 clip space corners of a quad. kept out of
+// renderer.cpp so bench.cpp can time it without a gl context
+
+struct Vertex {
+    v3 position;
+    v4 colour;
+    v2 uv;
+    i32 draw_type;
+};
+
+struct Quad {
+    Vertex vertices[4];
+};
+
+// VF_PACKED in the renderer, a third of the size of Vertex (48 bytes with
+// the v4 alignment). positions are clip space x, y as snorm16 over
+// -PACKED_CLIP_RANGE to PACKED_CLIP_RANGE so quads a few screens off the
+// edge still fit, which is under a tenth of a pixel a step at 1440 wide.
+// everything is drawn at z 0 so z isnt kept, colour is rgba8 and uvs are
+// unorm16
+#define PACKED_CLIP_RANGE 4.0f // has to match packed_vertex.shader
+
+struct PackedVertex {
+    i16 position[2];
+    u32 colour;
+    u16 uv[2];
+    u8 draw_type;
+    u8 padding[3];
+};
+
+static_assert(sizeof(PackedVertex) == 16, "PackedVertex should be 16 bytes");
+
+struct PackedQuad {
+    PackedVertex vertices[4];
+};
+
+// push_quad used to build translate * scale * rotate with 3 HMM_MulM4
+// then another for the view projection and 4 HMM_MulM4V4 for the corners,
+// 320 multiplies and 240 adds for a quad that only moves in x, y and
+// spins around z. most of those multiply by a 0 or 1 from the model matrix
+// so transform_quad writes out just the ones that arent, in the same order
+// hmm does them, which comes to about 30 multiplies and 40 adds.
+//
+// skipping x * 0 and x + 0 can only change the sign of a result that is
+// exactly 0, everything else comes out bit for bit the same as the old
+// matrix chain, bench.cpp checks this against transform_quad_matrices
+//
+// transform_quads does the same maths on a QuadBatch with one quad in
+// each simd lane, 8 with avx and 4 with sse. sin and cos are still done
+// one at a time with HMM_SinF/HMM_CosF, a vector sin wouldnt round the
+// same way
+#define QUAD_BATCH_SIZE 8
+
+struct QuadBatch {
+    i64 len;
+
+    alignas(32) f32 x[QUAD_BATCH_SIZE];
+    alignas(32) f32 y[QUAD_BATCH_SIZE];
+    alignas(32) f32 z[QUAD_BATCH_SIZE];
+    alignas(32) f32 width[QUAD_BATCH_SIZE];
+    alignas(32) f32 height[QUAD_BATCH_SIZE];
+    alignas(32) f32 rotation[QUAD_BATCH_SIZE]; // degrees
+
+    // where the positions go, everything else in the quad is left alone.
+    // packed is used instead by batch_packed_quad/transform_packed_quads
+    Quad *quads[QUAD_BATCH_SIZE];
+    PackedQuad *packed[QUAD_BATCH_SIZE];
+};
+
+// the world space rectangle the camera sees. push_quad drops anything
+// entirely outside it before doing any vertex work, asteroids spawn well
+// off screen and missles live out to 1000 units so a lot of what the game
+// draws is never seen
+struct CullBounds {
+    v2 min;
+    v2 max;
+};
+
+bool quad_visible(CullBounds bounds, v3 position, v2 size, f32 rotation);
+u64 quad_tiles(CullBounds bounds, v3 position, v2 size);
+void transform_quad_matrices(m4 view_projection, v3 position, v2 size, f32 rotation, Quad *quad);
+void transform_quad(m4 view_projection, v3 position, v2 size, f32 rotation, Quad *quad);
+void transform_quads(m4 view_projection, QuadBatch *batch);
+i64 transform_corners(m4 view_projection, QuadBatch *batch, f32 corners[4][3][QUAD_BATCH_SIZE]);
+bool batch_quad(QuadBatch *batch, v3 position, v2 size, f32 rotation, Quad *quad);
+bool batch_packed_quad(QuadBatch *batch, v3 position, v2 size, f32 rotation, PackedQuad *packed);
+void transform_packed_quads(m4 view_projection, QuadBatch *batch);
+void pack_positions(Quad *quad, PackedQuad *packed);
+u32 pack_colour(v4 colour);
+u16 pack_unorm16(f32 value);
+i16 pack_snorm16(f32 value);
+
+// conservative, anything that might touch the bounds is kept. the circle
+// through the corners covers the quad at any rotation so most quads are
+// decided without sin and cos, only ones whose circle crosses an edge get
+// the box around the rotated quad worked out
+bool quad_visible(CullBounds bounds, v3 position, v2 size, f32 rotation) {
+    f32 half_x = size.X * 0.5f;
+    f32 half_y = size.Y * 0.5f;
+    f32 radius = sqrtf(half_x * half_x + half_y * half_y);
+
+    if (position.X + radius < bounds.min.X || position.X - radius > bounds.max.X ||
+        position.Y + radius < bounds.min.Y || position.Y - radius > bounds.max.Y) {
+        return false;
+    }
+
+    if (position.X - radius >= bounds.min.X && position.X + radius <= bounds.max.X &&
+        position.Y - radius >= bounds.min.Y && position.Y + radius <= bounds.max.Y) {
+        return true;
+    }
+
+    f32 angle = rotation * HMM_DegToRad;
+    f32 sine = fabsf(HMM_SinF(angle));
+    f32 cosine = fabsf(HMM_CosF(angle));
+
+    f32 extent_x = cosine * half_x + sine * half_y;
+    f32 extent_y = sine * half_x + cosine * half_y;
+
+    return position.X + extent_x >= bounds.min.X && position.X - extent_x <= bounds.max.X &&
+           position.Y + extent_y >= bounds.min.Y && position.Y - extent_y <= bounds.max.Y;
+}
+
+// bounds cut into 8x8 tiles, a bit for each tile the circle through the
+// quad's corners touches so it's right at any rotation. two quads whose
+// tiles don't share a bit can't overlap, anything outside bounds counts
+// as the edge tiles
+u64 quad_tiles(CullBounds bounds, v3 position, v2 size) {
+    f32 radius = 0.5f * sqrtf(size.X * size.X + size.Y * size.Y);
+
+    f32 tiles_x = 8.0f / (bounds.max.X - bounds.min.X);
+    f32 tiles_y = 8.0f / (bounds.max.Y - bounds.min.Y);
+
+    i64 x0 = (i64) HMM_Clamp(0.0f, (position.X - radius - bounds.min.X) * tiles_x, 7.0f);
+    i64 x1 = (i64) HMM_Clamp(0.0f, (position.X + radius - bounds.min.X) * tiles_x, 7.0f);
+    i64 y0 = (i64) HMM_Clamp(0.0f, (position.Y - radius - bounds.min.Y) * tiles_y, 7.0f);
+    i64 y1 = (i64) HMM_Clamp(0.0f, (position.Y + radius - bounds.min.Y) * tiles_y, 7.0f);
+
+    u64 row = ((1ull << (x1 - x0 + 1)) - 1) << x0;
+    u64 tiles = 0;
+
+    for (i64 y = y0; y <= y1; y++) {
+        tiles |= row << (y * 8);
+    }
+
+    return tiles;
+}
+
+// the original push_quad maths, kept as the reference
+void transform_quad_matrices(m4 view_projection, v3 position, v2 size, f32 rotation, Quad *quad) {
+    const v4 top_left      = {-0.5,   0.5, 0, 1};
+    const v4 top_right     = { 0.5,   0.5, 0, 1};
+    const v4 bottom_right  = { 0.5,  -0.5, 0, 1};
+    const v4 bottom_left   = {-0.5,  -0.5, 0, 1};
+
+    m4 model_matrix = HMM_M4D(1.0f);
+    model_matrix = HMM_MulM4(model_matrix, HMM_Translate(position));
+    model_matrix = HMM_MulM4(model_matrix, HMM_Scale({size.X, size.Y, 1}));
+    model_matrix = HMM_MulM4(model_matrix, HMM_Rotate_LH(rotation * HMM_DegToRad, {0, 0, 1}));
+
+    m4 mvp_matrix = HMM_MulM4(view_projection, model_matrix);
+
+    quad->vertices[0].position = HMM_MulM4V4(mvp_matrix, top_left).XYZ;
+    quad->vertices[1].position = HMM_MulM4V4(mvp_matrix, top_right).XYZ;
+    quad->vertices[2].position = HMM_MulM4V4(mvp_matrix, bottom_right).XYZ;
+    quad->vertices[3].position = HMM_MulM4V4(mvp_matrix, bottom_left).XYZ;
+}
+
+void transform_quad(m4 view_projection, v3 position, v2 size, f32 rotation, Quad *quad) {
+    // HMM_Rotate_LH is HMM_Rotate_RH with the angle flipped
+    f32 angle = -(rotation * HMM_DegToRad);
+    f32 sine = HMM_SinF(angle);
+    f32 cosine = HMM_CosF(angle);
+
+    // the x and y columns of the model matrix, the rest is 0 or 1 apart
+    // from the translation
+    f32 x_x = size.X * cosine;
+    f32 x_y = size.Y * sine;
+    f32 y_x = size.X * (0.0f - sine);
+    f32 y_y = size.Y * cosine;
+
+    v4 *columns = view_projection.Columns;
+
+    for (i64 i = 0; i < 3; i++) {
+        // the x, y and translation columns of the model view projection
+        f32 x = columns[0].Elements[i] * x_x + columns[1].Elements[i] * x_y;
+        f32 y = columns[0].Elements[i] * y_x + columns[1].Elements[i] * y_y;
+        f32 t = ((columns[0].Elements[i] * position.X + columns[1].Elements[i] * position.Y) + columns[2].Elements[i] * position.Z) + columns[3].Elements[i];
+
+        f32 half_x = x * 0.5f;
+        f32 half_y = y * 0.5f;
+
+        quad->vertices[0].position.Elements[i] = (-half_x +  half_y) + t; // top left
+        quad->vertices[1].position.Elements[i] = ( half_x +  half_y) + t; // top right
+        quad->vertices[2].position.Elements[i] = ( half_x + -half_y) + t; // bottom right
+        quad->vertices[3].position.Elements[i] = (-half_x + -half_y) + t; // bottom left
+    }
+}
+
+void transform_quads(m4 view_projection, QuadBatch *batch) {
+    // corners[corner][axis][lane]
+    alignas(32) f32 corners[4][3][QUAD_BATCH_SIZE];
+
+    i64 i = transform_corners(view_projection, batch, corners);
+
+    for (i64 lane = 0; lane < i; lane++) {
+        Quad *quad = batch->quads[lane];
+
+        for (i64 corner = 0; corner < 4; corner++) {
+            quad->vertices[corner].position = {corners[corner][0][lane], corners[corner][1][lane], corners[corner][2][lane]};
+        }
+    }
+
+    // whatever didnt fill a register, or everything with no simd
+    for (; i < batch->len; i++) {
+        v3 position = {batch->x[i], batch->y[i], batch->z[i]};
+        v2 size = {batch->width[i], batch->height[i]};
+
+        transform_quad(view_projection, position, size, batch->rotation[i], batch->quads[i]);
+    }
+
+    batch->len = 0;
+}
+
+// the simd part of transform_quads, fills corners for the lanes that
+// filled a register and returns how many that was
+i64 transform_corners(m4 view_projection, QuadBatch *batch, f32 corners[4][3][QUAD_BATCH_SIZE]) {
+    alignas(32) f32 sins[QUAD_BATCH_SIZE];
+    alignas(32) f32 coses[QUAD_BATCH_SIZE];
+
+    for (i64 i = 0; i < batch->len; i++) {
+        f32 angle = -(batch->rotation[i] * HMM_DegToRad);
+        sins[i] = HMM_SinF(angle);
+        coses[i] = HMM_CosF(angle);
+    }
+
+    v4 *columns = view_projection.Columns;
+
+    i64 i = 0;
+
+#if defined(__AVX__)
+    for (; i + 8 <= batch->len; i += 8) {
+        __m256 sine = _mm256_load_ps(sins + i);
+        __m256 cosine = _mm256_load_ps(coses + i);
+        __m256 width = _mm256_load_ps(batch->width + i);
+        __m256 height = _mm256_load_ps(batch->height + i);
+        __m256 x = _mm256_load_ps(batch->x + i);
+        __m256 y = _mm256_load_ps(batch->y + i);
+        __m256 z = _mm256_load_ps(batch->z + i);
+
+        __m256 half = _mm256_set1_ps(0.5f);
+        __m256 sign = _mm256_set1_ps(-0.0f);
+
+        __m256 x_x = _mm256_mul_ps(width, cosine);
+        __m256 x_y = _mm256_mul_ps(height, sine);
+        __m256 y_x = _mm256_mul_ps(width, _mm256_sub_ps(_mm256_setzero_ps(), sine));
+        __m256 y_y = _mm256_mul_ps(height, cosine);
+
+        for (i64 axis = 0; axis < 3; axis++) {
+            __m256 column_x = _mm256_set1_ps(columns[0].Elements[axis]);
+            __m256 column_y = _mm256_set1_ps(columns[1].Elements[axis]);
+            __m256 column_z = _mm256_set1_ps(columns[2].Elements[axis]);
+            __m256 column_w = _mm256_set1_ps(columns[3].Elements[axis]);
+
+            __m256 mvp_x = _mm256_add_ps(_mm256_mul_ps(column_x, x_x), _mm256_mul_ps(column_y, x_y));
+            __m256 mvp_y = _mm256_add_ps(_mm256_mul_ps(column_x, y_x), _mm256_mul_ps(column_y, y_y));
+            __m256 t = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(column_x, x), _mm256_mul_ps(column_y, y)), _mm256_mul_ps(column_z, z)), column_w);
+
+            __m256 half_x = _mm256_mul_ps(mvp_x, half);
+            __m256 half_y = _mm256_mul_ps(mvp_y, half);
+            __m256 negative_x = _mm256_xor_ps(half_x, sign);
+            __m256 negative_y = _mm256_xor_ps(half_y, sign);
+
+            _mm256_store_ps(corners[0][axis] + i, _mm256_add_ps(_mm256_add_ps(negative_x, half_y), t));
+            _mm256_store_ps(corners[1][axis] + i, _mm256_add_ps(_mm256_add_ps(half_x, half_y), t));
+            _mm256_store_ps(corners[2][axis] + i, _mm256_add_ps(_mm256_add_ps(half_x, negative_y), t));
+            _mm256_store_ps(corners[3][axis] + i, _mm256_add_ps(_mm256_add_ps(negative_x, negative_y), t));
+        }
+    }
+#elif defined(HANDMADE_MATH__USE_SSE)
+    for (; i + 4 <= batch->len; i += 4) {
+        __m128 sine = _mm_load_ps(sins + i);
+        __m128 cosine = _mm_load_ps(coses + i);
+        __m128 width = _mm_load_ps(batch->width + i);
+        __m128 height = _mm_load_ps(batch->height + i);
+        __m128 x = _mm_load_ps(batch->x + i);
+        __m128 y = _mm_load_ps(batch->y + i);
+        __m128 z = _mm_load_ps(batch->z + i);
+
+        __m128 half = _mm_set1_ps(0.5f);
+        __m128 sign = _mm_set1_ps(-0.0f);
+
+        __m128 x_x = _mm_mul_ps(width, cosine);
+        __m128 x_y = _mm_mul_ps(height, sine);
+        __m128 y_x = _mm_mul_ps(width, _mm_sub_ps(_mm_setzero_ps(), sine));
+        __m128 y_y = _mm_mul_ps(height, cosine);
+
+        for (i64 axis = 0; axis < 3; axis++) {
+            __m128 column_x = _mm_set1_ps(columns[0].Elements[axis]);
+            __m128 column_y = _mm_set1_ps(columns[1].Elements[axis]);
+            __m128 column_z = _mm_set1_ps(columns[2].Elements[axis]);
+            __m128 column_w = _mm_set1_ps(columns[3].Elements[axis]);
+
+            __m128 mvp_x = _mm_add_ps(_mm_mul_ps(column_x, x_x), _mm_mul_ps(column_y, x_y));
+            __m128 mvp_y = _mm_add_ps(_mm_mul_ps(column_x, y_x), _mm_mul_ps(column_y, y_y));
+            __m128 t = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(column_x, x), _mm_mul_ps(column_y, y)), _mm_mul_ps(column_z, z)), column_w);
+
+            __m128 half_x = _mm_mul_ps(mvp_x, half);
+            __m128 half_y = _mm_mul_ps(mvp_y, half);
+            __m128 negative_x = _mm_xor_ps(half_x, sign);
+            __m128 negative_y = _mm_xor_ps(half_y, sign);
+
+            _mm_store_ps(corners[0][axis] + i, _mm_add_ps(_mm_add_ps(negative_x, half_y), t));
+            _mm_store_ps(corners[1][axis] + i, _mm_add_ps(_mm_add_ps(half_x, half_y), t));
+            _mm_store_ps(corners[2][axis] + i, _mm_add_ps(_mm_add_ps(half_x, negative_y), t));
+            _mm_store_ps(corners[3][axis] + i, _mm_add_ps(_mm_add_ps(negative_x, negative_y), t));
+        }
+    }
+#endif
+
+    return i;
+}
+
+// adds a quad to the batch, returns true once it is full and needs a
+// transform_quads
+bool batch_quad(QuadBatch *batch, v3 position, v2 size, f32 rotation, Quad *quad) {
+    assert(batch->len < QUAD_BATCH_SIZE);
+
+    i64 i = batch->len;
+    batch->x[i] = position.X;
+    batch->y[i] = position.Y;
+    batch->z[i] = position.Z;
+    batch->width[i] = size.X;
+    batch->height[i] = size.Y;
+    batch->rotation[i] = rotation;
+    batch->quads[i] = quad;
+
+    batch->len += 1;
+
+    return batch->len == QUAD_BATCH_SIZE;
+}
+
+// same as batch_quad for the packed format, the positions end up in
+// packed and the rest of the quad is left alone
+bool batch_packed_quad(QuadBatch *batch, v3 position, v2 size, f32 rotation, PackedQuad *packed) {
+    batch->packed[batch->len] = packed;
+
+    return batch_quad(batch, position, size, rotation, nullptr);
+}
+
+// the same simd corners as transform_quads, packed straight from the
+// lanes 4 at a time. going through a Quad for each made packed quads
+// slower to write than float ones
+void transform_packed_quads(m4 view_projection, QuadBatch *batch) {
+    alignas(32) f32 corners[4][3][QUAD_BATCH_SIZE];
+
+    i64 i = transform_corners(view_projection, batch, corners);
+
+#if defined(HANDMADE_MATH__USE_SSE)
+    // same rounding and clamp as pack_positions. each lane's x, y is one
+    // u32 with x in the low half, the order they sit in PackedVertex
+    __m128 scale = _mm_set1_ps(32767.0f / PACKED_CLIP_RANGE);
+    __m128 low = _mm_set1_ps(-32767.0f);
+    __m128 high = _mm_set1_ps(32767.0f);
+    __m128i low_half = _mm_set1_epi32(0xffff);
+
+    for (i64 corner = 0; corner < 4; corner++) {
+        for (i64 lane = 0; lane < i; lane += 4) {
+            __m128 x = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_load_ps(corners[corner][0] + lane), scale), low), high);
+            __m128 y = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_load_ps(corners[corner][1] + lane), scale), low), high);
+
+            __m128i xy = _mm_or_si128(_mm_and_si128(_mm_cvtps_epi32(x), low_half), _mm_slli_epi32(_mm_cvtps_epi32(y), 16));
+
+            alignas(16) u32 positions[4];
+            _mm_store_si128((__m128i *) positions, xy);
+
+            for (i64 j = 0; j < 4; j++) {
+                memcpy(batch->packed[lane + j]->vertices[corner].position, &positions[j], sizeof(u32));
+            }
+        }
+    }
+#else
+    assert(i == 0);
+#endif
+
+    // whatever didnt fill a register, or everything with no simd
+    for (; i < batch->len; i++) {
+        v3 position = {batch->x[i], batch->y[i], batch->z[i]};
+        v2 size = {batch->width[i], batch->height[i]};
+
+        Quad quad;
+        transform_quad(view_projection, position, size, batch->rotation[i], &quad);
+        pack_positions(&quad, batch->packed[i]);
+    }
+
+    batch->len = 0;
+}
+
+// the x, y of all 4 corners to snorm16 over PACKED_CLIP_RANGE, z is dropped
+void pack_positions(Quad *quad, PackedQuad *packed) {
+#if defined(HANDMADE_MATH__USE_SSE)
+    // the clamp is to +-32767 before rounding so -1 comes out as -32767
+    // like pack_snorm16, cvtps rounds to nearest even under the default
+    // rounding mode and packs saturates but never has to
+    __m128 scale = _mm_set1_ps(32767.0f / PACKED_CLIP_RANGE);
+    __m128 low = _mm_set1_ps(-32767.0f);
+    __m128 high = _mm_set1_ps(32767.0f);
+
+    Vertex *v = quad->vertices;
+    __m128 a = _mm_setr_ps(v[0].position.X, v[0].position.Y, v[1].position.X, v[1].position.Y);
+    __m128 b = _mm_setr_ps(v[2].position.X, v[2].position.Y, v[3].position.X, v[3].position.Y);
+
+    a = _mm_min_ps(_mm_max_ps(_mm_mul_ps(a, scale), low), high);
+    b = _mm_min_ps(_mm_max_ps(_mm_mul_ps(b, scale), low), high);
+
+    alignas(16) i16 positions[8];
+    _mm_store_si128((__m128i *) positions, _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b)));
+
+    for (i64 i = 0; i < 4; i++) {
+        packed->vertices[i].position[0] = positions[i * 2 + 0];
+        packed->vertices[i].position[1] = positions[i * 2 + 1];
+    }
+#else
+    for (i64 i = 0; i < 4; i++) {
+        v3 position = quad->vertices[i].position;
+
+        packed->vertices[i].position[0] = pack_snorm16(position.X / PACKED_CLIP_RANGE);
+        packed->vertices[i].position[1] = pack_snorm16(position.Y / PACKED_CLIP_RANGE);
+    }
+#endif
+}
+
+// rgba8, r in the lowest byte so it reads back in order as 4 bytes
+u32 pack_colour(v4 colour) {
+    u32 r = (u32) (HMM_Clamp(0.0f, colour.R, 1.0f) * 255.0f + 0.5f);
+    u32 g = (u32) (HMM_Clamp(0.0f, colour.G, 1.0f) * 255.0f + 0.5f);
+    u32 b = (u32) (HMM_Clamp(0.0f, colour.B, 1.0f) * 255.0f + 0.5f);
+    u32 a = (u32) (HMM_Clamp(0.0f, colour.A, 1.0f) * 255.0f + 0.5f);
+
+    return r | (g << 8) | (b << 16) | (a << 24);
+}
+
+u16 pack_unorm16(f32 value) {
+    return (u16) (HMM_Clamp(0.0f, value, 1.0f) * 65535.0f + 0.5f);
+}
+
+// rounds to nearest even like the sse path in pack_positions, anything
+// outside -1 to 1 is clamped
+i16 pack_snorm16(f32 value) {
+    return (i16) nearbyintf(HMM_Clamp(-1.0f, value, 1.0f) * 32767.0f);
+}
+
+#endif
@@ -1,20 +1,233 @@
 #ifndef RENDERER_CPP
 #define RENDERER_CPP
 
-#include "libs/libs.h"
+#include "backend.h"
 #include "game.h"
 
-#define MAX_QUADS 2000
+// there is no limit on quads a frame, they are drawn BATCH_QUADS at a
+// time and push_quad flushes a draw whenever a batch fills up. 4 vertices
+// a quad so a batch has to fit in u16 indices
+#ifndef BATCH_QUADS
+#define BATCH_QUADS 4096
+#endif
 
-struct Vertex {
-    v3 position;
-    v4 colour;
-    v2 uv;
+static_assert(BATCH_QUADS * 4 <= 65536, "BATCH_QUADS is too big for u16 indices");
+
+// two ways to get quads to the gpu, RP_VERTICES builds all 4 vertices on
+// the cpu like it always has, RP_INSTANCED sends one Instance per quad
+// and instanced_vertex.shader works out the corners. picked at init and
+// only the one picked gets buffers and programs
+enum RenderPath {
+    RP_VERTICES,
+    RP_INSTANCED,
+};
+
+// what the RP_VERTICES path writes for each corner, Vertex with f32
+// everything or PackedVertex, see quad.cpp. picked at init like the path
+enum VertexFormat {
+    VF_FLOATS,
+    VF_PACKED,
+};
+
+// FM_BAKED is stbtt_BakeFontBitmap coverage at one big pixel height that
+// gets filtered down to whatever size text is drawn at, FM_SDF is a signed
+// distance field per glyph from stbtt_GetCodepointSDF at a small height
+// that the font program thresholds, so one much smaller atlas stays sharp
+// at every size. picked at init since the font program is built for it
+enum FontMode {
+    FM_BAKED,
+    FM_SDF,
+};
+
+// what a quad is drawn with, the same numbers as draw_type. each material
+// has its own program built from fragment.shader with MATERIAL defined so
+// nothing branches per fragment, and its own batch
+enum Material {
+    MT_RECTANGLE,
+    MT_CIRCLE,
+    MT_TEXTURE,
+    MT_FONT,
+    MT_COUNT__
+};
+
+// everything drawn is at z 0 so only x, y are kept. colour is rgba8 and
+// the uvs are the top left and bottom right corners as unorm16
+struct Instance {
+    v2 position;
+    v2 size;
+    f32 rotation; // degrees
+    u32 colour;
+    u16 uvs[4];
     i32 draw_type;
 };
 
-struct Quad {
-    Vertex vertices[4];
+// the draw_* functions dont write any vertices, push_quad culls and
+// queues a RenderCommand with a sort key and draw_frame radix sorts the
+// keys and writes the vertices in key order. most significant first
+//
+//     layer     8 bits  next_layer, later layers go over earlier ones
+//     depth    20 bits  far to near, from position.Z
+//     sequence 32 bits  push order, the command's index in the queue
+//     material  4 bits  which batch it goes in
+//
+// so key order is the order things have to be drawn in and callers dont
+// have to care what order they draw in. each material still fills its own
+// batch and they're drawn together, flush_commands only draws them early
+// when a quad would go under one already waiting in another batch
+#define SORT_KEY_LAYER_SHIFT 56
+#define SORT_KEY_DEPTH_SHIFT 36
+#define SORT_KEY_SEQUENCE_SHIFT 4
+#define SORT_KEY_MATERIAL_MASK 0xf
+#define MAX_RENDER_LAYERS 256
+
+// what push_quad was given, packed down like Instance
+struct RenderCommand {
+    v3 position;
+    v2 size;
+    f32 rotation; // degrees
+    u32 colour;
+    u16 uvs[4];
+};
+
+// the quad and instance buffers are mapped once at init and written to
+// directly by push_quad, there is no copy in the renderer and no
+// glBufferSubData. the buffer is STREAM_REGIONS regions of BATCH_QUADS
+// back to back, each batch writes the next region while the gpu can still
+// be drawing the ones before it. a fence goes in after each batch's draw
+// and is waited on before the region is written again, which only blocks
+// if the gpu is STREAM_REGIONS batches behind
+//
+// a buffer can be split into rings that go round their own regions
+// separately, the renderer has a ring for each material
+#ifndef STREAM_REGIONS
+#define STREAM_REGIONS 3
+#endif
+
+#define MAX_STREAM_RINGS 8
+
+struct StreamBuffer {
+    u32 buffer_id;
+    i64 region_size; // bytes
+    i64 ring_count;
+    u8 *mapped;
+
+    // the region each ring is writing
+    i64 regions[MAX_STREAM_RINGS];
+    GLsync fences[MAX_STREAM_RINGS][STREAM_REGIONS];
+
+    // how often and how long begin_stream_region had to wait for the gpu
+    i64 waits;
+    f64 wait_time;
+};
+
+struct RenderStats {
+    i64 quads;
+    i64 culled; // pushed but outside the camera, see quad_visible
+    i64 batches;
+    i64 draw_calls;
+    i64 bytes_uploaded;
+
+    i64 layers;
+    i64 program_switches;
+    f64 sort_time;
+
+    // begin_stream_region waits
+    i64 stream_waits;
+    f64 stream_wait_time;
+
+    // seconds. render_time is drawing the frame up to and including the
+    // swap, render_wait_time the render thread waiting for it to be built
+    // and game_wait_time the game thread waiting for a packet to build it
+    // in. the waits are 0 without a render thread
+    f64 render_time;
+    f64 render_wait_time;
+    f64 game_wait_time;
+
+    // how many runs of the same material the quads came in, what drawing
+    // them in push order would have needed
+    i64 push_runs;
+
+    // batches drawn early because the next quad overlapped one of them,
+    // see flush_commands
+    i64 order_flushes;
+
+    // quad area in pixels for each material, what the fragment shaders
+    // have to cover
+    Array<f64, MT_COUNT__> pixels;
+
+    // draw_text calls that found their layout cached and ones that had
+    // to lay it out
+    i64 text_cached;
+    i64 text_laid_out;
+
+    // FM_SDF glyph cache
+    i64 glyphs_rasterized;
+    i64 glyph_pages_evicted;
+    i64 glyphs_dropped; // drawn as a space, every page was in use this frame
+    i64 font_bytes_uploaded;
+};
+
+// a changed part of a glyph page, see GlyphCache. the pixels are in
+// FramePacket.font_pixels
+#define MAX_GLYPH_PAGES 64 // pages a text layout uses fit in a u64
+
+struct FontUpload {
+    i32 x;
+    i32 y;
+    i32 width;
+    i32 height;
+    i64 offset;
+};
+
+// the game thread builds a frame into a FramePacket between new_frame and
+// draw_frame, everything that draws it is in there so a render thread
+// that owns the gl context can draw frame N while the game thread is
+// simulating and building frame N+1. FRAME_PACKETS of them go round in
+// order, with 2 the game thread can be at most one frame ahead and with 3
+// it can be two
+#ifndef FRAME_PACKETS
+#define FRAME_PACKETS 2
+#endif
+
+struct FramePacket {
+    // the queue, see RenderCommand. grows when full, see push_command
+    Slice<RenderCommand> commands;
+    Slice<u64> sort_keys;
+    Slice<u64> sort_scratch;
+    i64 command_capacity;
+    u8 layer;
+    i32 last_material;
+
+    i32 width;
+    i32 height;
+    m4 view_projection_matrix;
+    CullBounds cull_bounds;
+    f32 pixels_per_unit;
+
+    // the game thread's half, culled, push_runs, pixels and layers
+    RenderStats stats;
+
+    // glyphs the game thread added to the font atlas, see GlyphCache
+    Array<FontUpload, MAX_GLYPH_PAGES> font_uploads;
+    Slice<u8> font_pixels;
+    i64 font_pixels_capacity;
+
+    // dear imgui reuses its draw lists every NewFrame so the render thread
+    // gets clones
+    ImDrawData imgui_draw_data;
+};
+
+struct RenderThread {
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable built;
+    std::condition_variable drawn;
+
+    // the game thread builds packet packets_built % FRAME_PACKETS and the
+    // render thread draws packets_drawn % FRAME_PACKETS
+    i64 packets_built;
+    i64 packets_drawn;
+    bool quit;
 };
 
 struct Camera {
@@ -44,27 +257,216 @@ struct Atlas {
     u8 *data;
 };
 
+// what stbtt_GetBakedQuad gives for each character with the pen at 0, so
+// laying out text needs no stb calls. bottom_y is y+ up
+struct GlyphMetrics {
+    f32 bottom_y;
+    v2 size;
+    f32 advance;
+    v2 uvs[4];
+    i32 index; // in the font, for kerning
+};
+
 struct Font {
     i64 width;
     i64 height;
     Array<stbtt_bakedchar, 96> characters;
+    Array<GlyphMetrics, 96> glyphs;
     u8 *bitmap_data;
+
+    // stbtt_fontinfo points into font_data so it is kept. scale takes font
+    // units to the units the metrics are in
+    stbtt_fontinfo info;
+    Slice<u8> font_data;
+    f32 scale;
+
+    // FM_SDF glyph quads have this much distance field around the glyph
+    // on every side, in the same units as the metrics. 0 for FM_BAKED
+    f32 padding;
 };
 
-struct Renderer {
-    Array<Quad, MAX_QUADS> quads;
+// FM_SDF glyphs are made when text first uses them, any codepoint the
+// font has. the atlas is cut into pages, rows as tall as the font's
+// bounding box, that glyphs are added to left to right. when no page has
+// room the least recently used one is emptied and everything laid out
+// with it is laid out again. only the part of each page that changed
+// since the last frame is copied into the packet and uploaded
+#define GLYPH_CACHE_SLOTS 1024 // power of 2
+
+// codepoints the font doesn't have are all glyph 0, the .notdef box. it's
+// made once under this, past the last unicode codepoint so decode_utf8
+// never gives it, and the rest get a copy of its slot on the same pixels
+#define NOTDEF_CODEPOINT 0x110000
+
+struct CachedGlyph {
+    bool used;
+    u32 codepoint;
+    i32 page; // -1 for glyphs with nothing to draw like space
+    GlyphMetrics metrics;
+};
+
+struct GlyphPage {
+    i64 y;
+    i64 x; // where the next glyph goes
+    u64 last_used; // frame
+    // the columns changed since the last upload, empty when x0 >= x1
+    i64 dirty_x0;
+    i64 dirty_x1;
+};
+
+struct GlyphCache {
+    i32 padding;
+
+    CachedGlyph slots[GLYPH_CACHE_SLOTS];
+    i64 count;
+
+    // atlas, the same as Font.bitmap_data
+    u8 *bitmap;
+    i64 width;
+    i64 page_height;
+    Array<GlyphPage, MAX_GLYPH_PAGES> pages;
+
+    u64 frame;
+    // a page was emptied so cached text layouts might point at glyphs
+    // that aren't there any more
+    bool layouts_stale;
+};
+
+// what a font is baked at, main.cpp picks them and font_bake.cpp bakes a
+// blob with the same ones
+struct FontSettings {
+    FontMode mode;
+    f32 pixel_height;
+    i32 padding; // FM_SDF only
+    i64 width; // atlas
+    i64 height;
+};
+
+// stbtt_BakeFontBitmap or adding the ascii glyphs to the sdf atlas was
+// most of the time the game took to start, so font_bake.cpp does it once
+// and writes this. the header, the glyphs (GlyphMetrics for FM_BAKED or
+// CachedGlyph for FM_SDF), the sdf pages, the atlas and the ttf itself,
+// kerning and sdf glyphs made later still read it. load_font_blob maps
+// the file and uses it in place, so the structs in it are checked against
+// this build and the settings against what the game asked for. anything
+// different and the game bakes from the ttf like it always did
+#define FONT_BLOB_MAGIC 0x42544E46 // "FNTB"
+#define FONT_BLOB_VERSION 1
+#define FONT_BLOB_ALIGN(offset) (((offset) + 63) & ~(i64) 63)
+
+struct FontBlobHeader {
+    u32 magic;
+    u32 version;
+    u32 metrics_size;
+    u32 cached_glyph_size;
+    u32 page_size;
+
+    FontSettings settings;
+
+    i64 glyph_count;
+    i64 page_count;
+    i64 page_height;
+
+    // from the start of the file
+    i64 glyphs_offset;
+    i64 pages_offset;
+    i64 bitmap_offset;
+    i64 font_data_offset;
+    i64 font_data_size;
+};
+
+// draw_text lays a string out once and keeps the scaled glyph quads here
+// keyed by the text and font size, most labels are the same every frame
+// so after the first one they are just pushed. the table and the arena
+// the layouts live in are cleared together when either fills up
+#define TEXT_LAYOUT_SLOTS 4096 // power of 2
+#define TEXT_LAYOUT_ARENA_SIZE (1024 * 1024)
+
+// uvs are packed top left and bottom right like RenderCommand
+struct LaidOutGlyph {
+    v2 centre; // from the text position
+    v2 size;
+    u16 uvs[4];
+};
+
+struct TextLayout {
+    u64 hash;
+    f32 font_size;
+    string text; // copy in the arena
+    Slice<LaidOutGlyph> glyphs; // len 0 for an empty slot
+    u64 pages; // bit for each glyph page it uses
+
+    // size is what measure_text gives, from the left of the first glyph to
+    // the right of the last and as tall as the font size. min and max are
+    // around every glyph quad including sdf padding, from the text position
+    v2 size;
+    v2 min;
+    v2 max;
+    f32 area; // of the glyph quads, for RenderStats.pixels
+};
+
+// one of the labels draw_labels draws, text has to stay valid until then
+struct Label {
+    string text;
+    v3 position;
+    f32 font_size;
+    v4 colour;
+};
+
+struct TextLayoutCache {
+    TextLayout slots[TEXT_LAYOUT_SLOTS];
+    i64 count;
+    Arena arena;
+};
 
+struct Renderer {
+    RenderPath path;
+    VertexFormat format;
+    FontMode font_mode;
+    i64 quad_bytes; // Quad, PackedQuad or Instance
+
+    // packet is the one the game thread is building. thread is nullptr
+    // when draw_frame draws on the game thread
+    Array<FramePacket, FRAME_PACKETS> packets;
+    FramePacket *packet;
+    RenderThread *thread;
+
+    // the current batch of each material, a region of its ring in stream.
+    // Quads, PackedQuads or Instances depending on the path and format
+    u8 *batches[MT_COUNT__];
+    i64 batch_lens[MT_COUNT__];
+    u64 batch_tiles[MT_COUNT__]; // quad_tiles of everything in the batch
+
+    StreamBuffer stream;
+
+    // RP_VERTICES quads that have their colour and uvs but are still
+    // waiting on positions, see transform_quads
+    QuadBatch quad_batch;
+
+    // stats is the render side of the frame being drawn, it goes in with
+    // the packet's when its done. frame_stats is the last frame drawn and
+    // total_stats every frame so far, both behind the thread's mutex, see
+    // get_frame_stats
+    RenderStats stats;
+    RenderStats frame_stats;
+    RenderStats total_stats;
+    u32 current_program;
+
+    // the packet being drawn's
     m4 view_projection_matrix;
 
     Array<Texture, TH_COUNT__> textures;
     Atlas atlas;
 
     Font font;
+    GlyphCache glyph_cache; // game thread, FM_SDF
+    TextLayoutCache text_layouts; // game thread
 
+    // for the path and format picked at init
     u32 vertex_array_id;
-    u32 vertex_buffer_id;
     u32 index_buffer_id;
-    u32 shader_program_id;
+    Array<u32, MT_COUNT__> programs;
+    Array<i32, MT_COUNT__> view_projection_locations;
 
     u32 atlas_texture_id;
     u32 font_texture_id;
@@ -76,19 +478,64 @@ v4 RED      = {1, 0, 0, 1};
 v4 GREEN    = {0, 1, 0, 1};
 v4 BLUE     = {0, 0, 1, 1};
 
-bool init_renderer(Renderer *renderer, Window *window);
+bool init_renderer(Renderer *renderer, Window *window, RenderPath path, VertexFormat format, FontMode font_mode, bool render_thread);
+bool start_render_thread(Renderer *renderer, Window *window);
+void stop_render_thread(Renderer *renderer, Window *window);
+void render_thread_main(Renderer *renderer, Window *window);
+void wait_for_frames(Renderer *renderer);
+RenderStats get_frame_stats(Renderer *renderer);
+RenderStats get_total_stats(Renderer *renderer);
+void add_stats(RenderStats *to, RenderStats *from);
+bool init_stream_buffer(StreamBuffer *stream, i64 region_size, i64 ring_count);
+u8 *begin_stream_region(StreamBuffer *stream, i64 ring);
+void end_stream_region(StreamBuffer *stream, i64 ring);
+i64 stream_region_index(StreamBuffer *stream, i64 ring);
+u32 load_shader_program(const char *vertex_path, const char *fragment_path, const char *defines);
+void shader_source(u32 shader, Slice<u8> source, const char *defines);
 bool load_textures(Renderer *renderer);
 u32 upload_texture_to_gpu(Renderer *renderer, i32 width, i32 height, u8 *data);
 u32 upload_font_to_gpu(Renderer *renderer, i32 width, i32 height, u8 *data);
-bool load_font(Renderer *renderer, string path, i64 width, i64 height, f32 pixel_height);
+bool load_font(Renderer *renderer, string path, FontSettings settings);
+bool load_font_blob(Renderer *renderer, string path, FontSettings settings);
+bool write_font_blob(Renderer *renderer, FontSettings settings, const char *path);
+void upload_font(Renderer *renderer);
+bool bake_font(Renderer *renderer, Slice<u8> font_data, FontSettings settings);
+bool bake_sdf_font(Renderer *renderer, Slice<u8> font_data, FontSettings settings);
+GlyphMetrics *get_glyph(Renderer *renderer, u32 codepoint, u64 *pages);
+u64 glyph_home_slot(u32 codepoint);
+CachedGlyph *find_cached_glyph(GlyphCache *cache, u32 codepoint);
+CachedGlyph *cache_glyph(Renderer *renderer, u32 codepoint);
+i64 make_room_for_glyph(Renderer *renderer, i64 width);
+i64 oldest_glyph_page(GlyphCache *cache);
+void evict_glyph_page(GlyphCache *cache, i64 page);
+void remove_cached_glyph(GlyphCache *cache, u64 slot);
+void touch_glyph_pages(GlyphCache *cache, u64 pages);
+void copy_font_uploads(GlyphCache *cache, FramePacket *packet);
+void clear_text_layouts(TextLayoutCache *cache);
+TextLayout *layout_text(Renderer *renderer, string text, f32 font_size);
+TextLayout *find_text_layout(TextLayoutCache *cache, u64 hash, string text, f32 font_size, TextLayout **empty_slot);
 
 void draw_rectangle(Renderer *renderer, v3 position, v2 size, v4 color);
 void draw_circle(Renderer *renderer, v3 position, f32 radius, v4 color);
 void draw_texture(Renderer *renderer, TextureHandle handle, v3 position, v2 size, f32 rotation, v4 color);
 void draw_text(Renderer *renderer, string text, v3 position, f32 font_size, v4 color);
+void draw_labels(Renderer *renderer, Slice<Label> labels);
+v2 measure_text(Renderer *renderer, string text, f32 font_size);
 void new_frame(Renderer *renderer, Window *window, Camera camera);
 void draw_frame(Renderer *renderer, Window *window);
+void draw_packet(Renderer *renderer, Window *window, FramePacket *packet);
+void copy_imgui_draw_data(ImDrawData *from, ImDrawData *to);
+void next_layer(Renderer *renderer);
+void flush_quads(Renderer *renderer);
+void flush_material(Renderer *renderer, Material material);
 void push_quad(Renderer *renderer, v3 position, v2 size, f32 rotation, v4 color, v2 uvs[4], i32 draw_type);
+void push_command(Renderer *renderer, RenderCommand command, Material material);
+void reserve_commands(Renderer *renderer, i64 count);
+void flush_commands(Renderer *renderer, FramePacket *packet);
+void write_quad(Renderer *renderer, RenderCommand *command, Material material);
+void write_instance(Renderer *renderer, RenderCommand *command, Material material);
+u64 make_sort_key(u8 layer, Material material, f32 depth, u32 sequence);
+u64 *radix_sort_keys(u64 *keys, u64 *scratch, i64 count, i64 first_byte);
 
 m4 get_view_matrix(Camera camera);
 m4 get_projection_matrix(Camera camera, f32 aspect);
@@ -96,7 +543,34 @@ const char *texture_path(TextureHandle handle);
 
 v4 alpha(v4 base, f32 alpha);
 
-bool init_renderer(Renderer *renderer, Window *window) {
+// render_thread only sets things up for one, start_render_thread starts
+// it once everything that needs the gl context on this thread is done
+bool init_renderer(Renderer *renderer, Window *window, RenderPath path, VertexFormat format, FontMode font_mode, bool render_thread) {
+    renderer->path = path;
+    renderer->format = format;
+    renderer->font_mode = font_mode;
+
+    // command queues, start at 4 batches worth
+    for (i64 i = 0; i < FRAME_PACKETS; i++) {
+        FramePacket *packet = &renderer->packets[i];
+
+        packet->command_capacity = BATCH_QUADS * 4;
+        packet->commands = mem_alloc<RenderCommand>(packet->command_capacity);
+        packet->sort_keys = mem_alloc<u64>(packet->command_capacity);
+        packet->sort_scratch = mem_alloc<u64>(packet->command_capacity);
+    }
+
+    renderer->packet = &renderer->packets[0];
+
+    if (!init_arena(&renderer->text_layouts.arena, TEXT_LAYOUT_ARENA_SIZE)) {
+        return false;
+    }
+    clear_text_layouts(&renderer->text_layouts);
+
+    if (render_thread) {
+        renderer->thread = new RenderThread();
+    }
+
     { // init opengl
         GLenum result = glewInit();
         if (result != GLEW_OK) {
@@ -121,74 +595,47 @@ bool init_renderer(Renderer *renderer, Window *window) {
     
         io.ConfigFlags |= ImGuiConfigFlags_NavEnableKeyboard;
         io.ConfigFlags |= ImGuiConfigFlags_DockingEnable;
-        io.ConfigFlags |= ImGuiConfigFlags_ViewportsEnable;
+
+        // the extra platform windows have to be made on the main thread
+        if (!render_thread) {
+            io.ConfigFlags |= ImGuiConfigFlags_ViewportsEnable;
+        }
     
         ImGui_ImplGlfw_InitForOpenGL(window->glfw_window, true);
         ImGui_ImplOpenGL3_Init("#version 460");
     }
 
-    { // load and compile shaders
-        const i64 buffer_size = 640;
-        i32 compile_status = 0;
-        i32 link_status = 0;
-        char error_buffer[buffer_size];
-    
-        Slice<u8> vertex_shader_source = read_file("./resources/shaders/vertex.shader");
-        if (vertex_shader_source.len == 0) {
-            printf("failed to load vertex shader");
-            return false;
-        }
-
-        Slice<u8> fragment_shader_source = read_file("./resources/shaders/fragment.shader");
-        if (fragment_shader_source.len == 0) {
-            printf("failed to load fragment shader");
-            return false;
-        }
-
-        u32 vertex_shader = glCreateShader(GL_VERTEX_SHADER);
-
-        glShaderSource(vertex_shader, 1, (char **) &vertex_shader_source.ptr, NULL);
-        glCompileShader(vertex_shader);
+    const char *vertex_shader_path = "./resources/shaders/vertex.shader";
+    renderer->quad_bytes = sizeof(Quad);
 
-        glGetShaderiv(vertex_shader, GL_COMPILE_STATUS, &compile_status);
-        if (compile_status == 0) {
-            glGetShaderInfoLog(vertex_shader, buffer_size, nullptr, &error_buffer[0]);
-            printf("failed to compile vertex shader: %s", error_buffer);
-            return false;
-        }
+    if (path == RP_VERTICES && format == VF_PACKED) {
+        vertex_shader_path = "./resources/shaders/packed_vertex.shader";
+        renderer->quad_bytes = sizeof(PackedQuad);
+    }
 
-        u32 fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
+    if (path == RP_INSTANCED) {
+        vertex_shader_path = "./resources/shaders/instanced_vertex.shader";
+        renderer->quad_bytes = sizeof(Instance);
+    }
 
-        glShaderSource(fragment_shader, 1, (char**) &fragment_shader_source.ptr, NULL);
-        glCompileShader(fragment_shader);
+    { // load and compile a program for each material
+        for (i64 i = 0; i < MT_COUNT__; i++) {
+            char defines[64];
+            sprintf(defines, "#define MATERIAL %lld\n#define FONT_SDF %d\n", (long long) i, font_mode == FM_SDF ? 1 : 0);
 
-        glGetShaderiv(fragment_shader, GL_COMPILE_STATUS, &compile_status);
-        if (compile_status == 0) {
-            glGetShaderInfoLog(fragment_shader, buffer_size, nullptr, &error_buffer[0]);
-            printf("failed to compile fragment shader: %s", error_buffer);
-            return false;
-        }
+            u32 shader_program = load_shader_program(vertex_shader_path, "./resources/shaders/fragment.shader", defines);
+            if (shader_program == 0) {
+                return false;
+            }
 
-        u32 shader_program = glCreateProgram();
-        glAttachShader(shader_program, vertex_shader);
-        glAttachShader(shader_program, fragment_shader);
-        glLinkProgram(shader_program);
+            renderer->programs[i] = shader_program;
+            renderer->view_projection_locations[i] = glGetUniformLocation(shader_program, "view_projection");
 
-        glGetProgramiv(shader_program, GL_LINK_STATUS, &link_status);
-        if (link_status == 0) {
-            glGetProgramInfoLog(shader_program, buffer_size, nullptr, &error_buffer[0]);
-            printf("failed to link shader program: %s", error_buffer);
-            return false;
+            // each one only uses one of these, the other location is -1 and ignored
+            glUseProgram(shader_program);
+            glUniform1i(glGetUniformLocation(shader_program, "atlas_texture"), 0);
+            glUniform1i(glGetUniformLocation(shader_program, "font_texture"), 1);
         }
-
-        renderer->shader_program_id = shader_program;
-
-        glUseProgram(shader_program);
-        glUniform1i(glGetUniformLocation(shader_program, "atlas_texture"), 0);
-        glUniform1i(glGetUniformLocation(shader_program, "font_texture"), 1);
-
-        glDeleteShader(vertex_shader);
-        glDeleteShader(fragment_shader);
     }
 
     { // vertex array
@@ -200,40 +647,40 @@ bool init_renderer(Renderer *renderer, Window *window) {
     }
 
     { // vertex buffer
-        u32 vertex_buffer;
-        glGenBuffers(1, &vertex_buffer);
-        glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(Quad) * MAX_QUADS, renderer->quads.data, GL_DYNAMIC_DRAW);
-
-        renderer->vertex_buffer_id = vertex_buffer;
+        bool ok = init_stream_buffer(&renderer->stream, renderer->quad_bytes * BATCH_QUADS, MT_COUNT__);
+        if (!ok) {
+            return false;
+        }
     }
 
-    { // index buffer
-        const i64 index_buffer_length = MAX_QUADS * 6;
-        u32 indices[index_buffer_length];
+    if (path == RP_VERTICES) { // index buffer, one batch worth shared by every region with a base vertex
+        const i64 index_buffer_length = BATCH_QUADS * 6;
+        Slice<u16> indices = mem_alloc<u16>(index_buffer_length);
 
         i64 i = 0;
         while (i < index_buffer_length) {
             // vertex offset pattern to draw a quad
             // { 0, 1, 2,  0, 2, 3 }
-            indices[i + 0] = ((i/6)*4 + 0);
-            indices[i + 1] = ((i/6)*4 + 1);
-            indices[i + 2] = ((i/6)*4 + 2);
-            indices[i + 3] = ((i/6)*4 + 0);
-            indices[i + 4] = ((i/6)*4 + 2);
-            indices[i + 5] = ((i/6)*4 + 3);
+            indices[i + 0] = (u16) ((i/6)*4 + 0);
+            indices[i + 1] = (u16) ((i/6)*4 + 1);
+            indices[i + 2] = (u16) ((i/6)*4 + 2);
+            indices[i + 3] = (u16) ((i/6)*4 + 0);
+            indices[i + 4] = (u16) ((i/6)*4 + 2);
+            indices[i + 5] = (u16) ((i/6)*4 + 3);
             i += 6;
         }
 
         u32 index_buffer;
         glGenBuffers(1, &index_buffer);
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(u32) * index_buffer_length, indices, GL_STATIC_DRAW);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(u16) * index_buffer_length, indices.ptr, GL_STATIC_DRAW);
+
+        mem_free(indices);
 
         renderer->index_buffer_id = index_buffer;
     }
 
-    { // vertex attributes
+    if (path == RP_VERTICES && format == VF_FLOATS) { // vertex attributes
         glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *) offsetof(Vertex, position));   // position
         glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *) offsetof(Vertex, colour));     // colour
         glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *) offsetof(Vertex, uv));         // uv
@@ -245,9 +692,192 @@ bool init_renderer(Renderer *renderer, Window *window) {
         glEnableVertexAttribArray(3);
     }
 
+    if (path == RP_VERTICES && format == VF_PACKED) { // packed vertex attributes
+        glVertexAttribPointer(0, 2, GL_SHORT, GL_TRUE, sizeof(PackedVertex), (void *) offsetof(PackedVertex, position));         // position
+        glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(PackedVertex), (void *) offsetof(PackedVertex, colour));   // colour
+        glVertexAttribPointer(2, 2, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(PackedVertex), (void *) offsetof(PackedVertex, uv));      // uv
+        glVertexAttribIPointer(3, 1, GL_UNSIGNED_BYTE, sizeof(PackedVertex), (void *) offsetof(PackedVertex, draw_type));        // draw_type
+
+        for (u32 i = 0; i < 4; i++) {
+            glEnableVertexAttribArray(i);
+        }
+    }
+
+    if (path == RP_INSTANCED) { // instance attributes, no per vertex data at all just one Instance per quad
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(Instance), (void *) offsetof(Instance, position));         // position
+        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Instance), (void *) offsetof(Instance, size));             // size
+        glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, sizeof(Instance), (void *) offsetof(Instance, rotation));         // rotation
+        glVertexAttribPointer(3, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Instance), (void *) offsetof(Instance, colour));    // colour
+        glVertexAttribPointer(4, 4, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(Instance), (void *) offsetof(Instance, uvs));      // uv rect
+        glVertexAttribIPointer(5, 1, GL_INT, sizeof(Instance), (void *) offsetof(Instance, draw_type));                   // draw_type
+
+        for (u32 i = 0; i < 6; i++) {
+            glEnableVertexAttribArray(i);
+            glVertexAttribDivisor(i, 1);
+        }
+    }
+
+    return true;
+}
+
+// makes the buffer, maps all of it and leaves it bound to GL_ARRAY_BUFFER
+// so the vertex attributes can be pointed at it
+bool init_stream_buffer(StreamBuffer *stream, i64 region_size, i64 ring_count) {
+    assert(ring_count <= MAX_STREAM_RINGS);
+
+    *stream = {
+        .region_size = region_size,
+        .ring_count = ring_count,
+    };
+
+    i64 size = region_size * STREAM_REGIONS * ring_count;
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+    glGenBuffers(1, &stream->buffer_id);
+    glBindBuffer(GL_ARRAY_BUFFER, stream->buffer_id);
+    glBufferStorage(GL_ARRAY_BUFFER, size, nullptr, flags);
+
+    stream->mapped = (u8 *) glMapBufferRange(GL_ARRAY_BUFFER, 0, size, flags);
+    if (!stream->mapped) {
+        printf("failed to map a %lld byte stream buffer\n", (long long) size);
+        return false;
+    }
+
     return true;
 }
 
+// waits for the gpu to be done with the ring's current region if it still
+// has a fence, safe to call more than once before end_stream_region
+u8 *begin_stream_region(StreamBuffer *stream, i64 ring) {
+    GLsync fence = stream->fences[ring][stream->regions[ring]];
+
+    if (fence) {
+        // poll first so the common case of the gpu being done costs nothing
+        GLenum result = glClientWaitSync(fence, 0, 0);
+
+        if (result == GL_TIMEOUT_EXPIRED) {
+            f64 start = time_now();
+
+            while (result == GL_TIMEOUT_EXPIRED) {
+                result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000); // 1ms
+            }
+
+            stream->waits += 1;
+            stream->wait_time += time_now() - start;
+        }
+
+        glDeleteSync(fence);
+        stream->fences[ring][stream->regions[ring]] = nullptr;
+    }
+
+    return stream->mapped + stream_region_index(stream, ring) * stream->region_size;
+}
+
+// call after the last draw that reads the ring's current region, fences it
+// and moves the ring on to its next one
+void end_stream_region(StreamBuffer *stream, i64 ring) {
+    stream->fences[ring][stream->regions[ring]] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    stream->regions[ring] = (stream->regions[ring] + 1) % STREAM_REGIONS;
+}
+
+// which region of the whole buffer the ring is on, for base vertex and
+// base instance
+i64 stream_region_index(StreamBuffer *stream, i64 ring) {
+    return ring * STREAM_REGIONS + stream->regions[ring];
+}
+
+// returns 0 if anything failed to load, compile or link. defines go in
+// after the #version line of both shaders, nullptr for none
+u32 load_shader_program(const char *vertex_path, const char *fragment_path, const char *defines) {
+    const i64 buffer_size = 640;
+    i32 compile_status = 0;
+    i32 link_status = 0;
+    char error_buffer[buffer_size];
+
+    Slice<u8> vertex_shader_source = read_file(vertex_path);
+    if (vertex_shader_source.len == 0) {
+        printf("failed to load vertex shader %s\n", vertex_path);
+        return 0;
+    }
+
+    Slice<u8> fragment_shader_source = read_file(fragment_path);
+    if (fragment_shader_source.len == 0) {
+        printf("failed to load fragment shader %s\n", fragment_path);
+        return 0;
+    }
+
+    u32 vertex_shader = glCreateShader(GL_VERTEX_SHADER);
+
+    shader_source(vertex_shader, vertex_shader_source, defines);
+    glCompileShader(vertex_shader);
+
+    glGetShaderiv(vertex_shader, GL_COMPILE_STATUS, &compile_status);
+    if (compile_status == 0) {
+        glGetShaderInfoLog(vertex_shader, buffer_size, nullptr, &error_buffer[0]);
+        printf("failed to compile vertex shader %s: %s", vertex_path, error_buffer);
+        return 0;
+    }
+
+    u32 fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
+
+    shader_source(fragment_shader, fragment_shader_source, defines);
+    glCompileShader(fragment_shader);
+
+    glGetShaderiv(fragment_shader, GL_COMPILE_STATUS, &compile_status);
+    if (compile_status == 0) {
+        glGetShaderInfoLog(fragment_shader, buffer_size, nullptr, &error_buffer[0]);
+        printf("failed to compile fragment shader %s: %s", fragment_path, error_buffer);
+        return 0;
+    }
+
+    u32 shader_program = glCreateProgram();
+    glAttachShader(shader_program, vertex_shader);
+    glAttachShader(shader_program, fragment_shader);
+    glLinkProgram(shader_program);
+
+    glGetProgramiv(shader_program, GL_LINK_STATUS, &link_status);
+    if (link_status == 0) {
+        glGetProgramInfoLog(shader_program, buffer_size, nullptr, &error_buffer[0]);
+        printf("failed to link shader program: %s", error_buffer);
+        return 0;
+    }
+
+    glDeleteShader(vertex_shader);
+    glDeleteShader(fragment_shader);
+
+    mem_free(vertex_shader_source);
+    mem_free(fragment_shader_source);
+
+    return shader_program;
+}
+
+void shader_source(u32 shader, Slice<u8> source, const char *defines) {
+    if (!defines) {
+        defines = "";
+    }
+
+    // #version has to be the first thing so the defines go after that line
+    i64 version_length = 0;
+    while (version_length < source.len && source[version_length] != '\n') {
+        version_length += 1;
+    }
+    version_length = min(version_length + 1, source.len);
+
+    const char *strings[3] = {
+        (const char *) source.ptr,
+        defines,
+        (const char *) source.ptr + version_length,
+    };
+
+    GLint lengths[3] = {
+        (GLint) version_length,
+        (GLint) strlen(defines),
+        (GLint) (source.len - version_length),
+    };
+
+    glShaderSource(shader, 3, strings, lengths);
+}
+
 bool load_textures(Renderer *renderer) {
     stbi_set_flip_vertically_on_load(true);
 
@@ -393,13 +1023,10 @@ u32 upload_font_to_gpu(Renderer *renderer, i32 width, i32 height, u8 *data) {
     return texture_id;
 }
 
-bool load_font(Renderer *renderer, string path, i64 width, i64 height, f32 pixel_height) {
-    Font font = Font{
-        .width = width,
-        .height = height,
-        .characters = {},
-        .bitmap_data = (u8 *) malloc(width * height),
-    };
+// the font from the ttf, baked in whichever mode settings has. what the
+// game does when there is no blob from font_bake.cpp or it is stale
+bool load_font(Renderer *renderer, string path, FontSettings settings) {
+    f64 start = time_now();
 
     Slice<u8> font_data = read_file(path.c());
     if (font_data.len == 0) {
@@ -407,227 +1034,1583 @@ bool load_font(Renderer *renderer, string path, i64 width, i64 height, f32 pixel
         return false;
     }
 
-    i64 bake_result = stbtt_BakeFontBitmap((const u8*)font_data.c(), 0, pixel_height, font.bitmap_data, font.width, font.height, 32, font.characters.size, font.characters.data);
-    if (bake_result <= 0) {
+    bool ok = settings.mode == FM_SDF ? bake_sdf_font(renderer, font_data, settings) : bake_font(renderer, font_data, settings);
+    if (!ok) {
         printf("failed to bake font \"%s\"\n", path.c());
         return false;
     }
 
-    { // write debug image out
-        stbi_flip_vertically_on_write(false);
-
-        i64 write_result = stbi_write_png("build/font.png", font.width, font.height, 1, font.bitmap_data, font.width);
-        if (write_result == 0) {
-            printf("error writing font to build folder\n");
-            return false;
-        }
-    }
-
-    renderer->font_texture_id = upload_font_to_gpu(renderer, font.width, font.height, font.bitmap_data);
-    assert(renderer->font_texture_id != 0);
+    upload_font(renderer);
 
-    renderer->font = font;
+    printf("%s font atlas %lldx%lld at %.0f px, %.1f KB, %.1f ms to bake from the ttf and upload\n",
+        settings.mode == FM_SDF ? "sdf" : "baked", (long long) settings.width, (long long) settings.height, settings.pixel_height,
+        (f64) (settings.width * settings.height) / 1024.0, (time_now() - start) * 1000.0);
 
     return true;
 }
 
-void draw_rectangle(Renderer *renderer, v3 position, v2 size, v4 color) {
-    v2 uvs[4] = {
-        {0, 1},
-        {1, 1},
-        {1, 0},
-        {0, 0},
-    };
-
-    push_quad(renderer, position, size, 0, color, uvs, 0);
-}
-
-void draw_circle(Renderer *renderer, v3 position, f32 radius, v4 color) {
-    v2 size = {radius * 2, radius * 2};
+// the font font_bake.cpp baked into path, mapped and uploaded without
+// copying anything but the FM_SDF atlas, which glyphs are added to. false
+// if there is no blob or it doesn't match settings and this build, so the
+// ttf can be loaded instead
+bool load_font_blob(Renderer *renderer, string path, FontSettings settings) {
+    f64 start = time_now();
 
-    v2 uvs[4] = {
-        {0, 1},
-        {1, 1},
-        {1, 0},
-        {0, 0},
-    };
+    Slice<u8> blob = map_file(path.c());
+    if (blob.len < (i64) sizeof(FontBlobHeader)) {
+        printf("no font blob at \"%s\", run font_bake\n", path.c());
+        return false;
+    }
 
-    push_quad(renderer, position, size, 0, color, uvs, 1);
-}
+    FontBlobHeader *header = (FontBlobHeader *) blob.ptr;
 
-void draw_texture(Renderer *renderer, TextureHandle handle, v3 position, v2 size, f32 rotation, v4 color) {
-    Texture *texture = &renderer->textures[handle];
-    push_quad(renderer, position, size, rotation, color, texture->uvs, 2);
-}
+    bool same_build = header->magic == FONT_BLOB_MAGIC && header->version == FONT_BLOB_VERSION &&
+        header->metrics_size == sizeof(GlyphMetrics) && header->cached_glyph_size == sizeof(CachedGlyph) &&
+        header->page_size == sizeof(GlyphPage);
+    if (!same_build) {
+        printf("font blob \"%s\" is from another version of font_bake, run it again\n", path.c());
+        return false;
+    }
 
-void draw_text(Renderer *renderer, string text, v3 position, f32 font_size, v4 color) {
-    if (text.len == 0) {
-        return;
+    FontSettings baked = header->settings;
+    bool same_settings = baked.mode == settings.mode && baked.pixel_height == settings.pixel_height &&
+        baked.padding == settings.padding && baked.width == settings.width && baked.height == settings.height;
+    if (!same_settings) {
+        printf("font blob \"%s\" was baked with other settings, run font_bake again\n", path.c());
+        return false;
     }
 
-    struct Glyph {
-        v2 position;
-        v2 size;
-        v2 uvs[4];
-    };
+    i64 glyph_size = settings.mode == FM_SDF ? sizeof(CachedGlyph) : sizeof(GlyphMetrics);
+    bool fits = header->glyphs_offset + header->glyph_count * glyph_size <= blob.len &&
+        header->pages_offset + header->page_count * (i64) sizeof(GlyphPage) <= blob.len &&
+        header->bitmap_offset + settings.width * settings.height <= blob.len &&
+        header->font_data_offset + header->font_data_size <= blob.len;
+    if (!fits) {
+        printf("font blob \"%s\" is cut short\n", path.c());
+        return false;
+    }
 
-    Slice<Glyph> glyphs = mem_alloc<Glyph>(text.len);
+    Font font = {};
+    font.width = settings.width;
+    font.height = settings.height;
+    font.padding = settings.mode == FM_SDF ? (f32) settings.padding : 0;
 
-    f32 total_text_width = 0;
-    f32 text_height = 0;
+    // kerning and glyphs the sdf cache makes later read the ttf from the
+    // mapping the same as they would from read_file
+    font.font_data = make_slice(blob.ptr + header->font_data_offset, header->font_data_size);
+    if (!stbtt_InitFont(&font.info, font.font_data.ptr, stbtt_GetFontOffsetForIndex(font.font_data.ptr, 0))) {
+        printf("failed to read the font in font blob \"%s\"\n", path.c());
+        return false;
+    }
 
-    for (i64 i = 0; i < text.len; i++) {
-        char c = text[i];
+    font.scale = stbtt_ScaleForPixelHeight(&font.info, settings.pixel_height);
 
-        f32 advanced_x = 0;
-        f32 advanced_y = 0;
-        stbtt_aligned_quad aligned_quad = {};
+    u8 *bitmap = blob.ptr + header->bitmap_offset;
 
-        // this is the the data for the aligned_quad we're given, with y+ going down
-        //	   x0, y0       x1, y0
-        //     s0, t0       s1, t0
-        //	    o tl        o tr
-                        
-                        
-        //     x0, y1      x1, y1
-        //     s0, t1      s1, t1
-        //	    o bl        o br
-        // 
-        // x, and y and expected vertex positions
-        // s and t are texture uv position
- 
-        stbtt_GetBakedQuad(renderer->font.characters.data, renderer->font.width, renderer->font.height, c - 32, &advanced_x, &advanced_y, &aligned_quad, false);
+    if (settings.mode == FM_BAKED) {
+        if (header->glyph_count != font.glyphs.size) {
+            printf("font blob \"%s\" has %lld glyphs, not %lld\n", path.c(), (long long) header->glyph_count, (long long) font.glyphs.size);
+            return false;
+        }
 
-        f32 bottom_y = -aligned_quad.y1;
-        f32 top_y = -aligned_quad.y0;
+        memcpy(font.glyphs.data, blob.ptr + header->glyphs_offset, sizeof(GlyphMetrics) * font.glyphs.size);
 
-        f32 height = top_y - bottom_y;
-        f32 width = aligned_quad.x1 - aligned_quad.x0;
+        // only ever uploaded
+        font.bitmap_data = bitmap;
+    } else {
+        GlyphCache *cache = &renderer->glyph_cache;
 
-        if (height > text_height) {
-            text_height = height;
+        if (header->page_count == 0 || header->page_count > MAX_GLYPH_PAGES || header->glyph_count * 4 > GLYPH_CACHE_SLOTS * 3) {
+            printf("font blob \"%s\" has more glyphs or pages than the glyph cache\n", path.c());
+            return false;
         }
 
-        v2 top_left_uv     = v2{aligned_quad.s0, aligned_quad.t0};
-        v2 top_right_uv    = v2{aligned_quad.s1, aligned_quad.t0};
-        v2 bottom_right_uv = v2{aligned_quad.s1, aligned_quad.t1};
-        v2 bottom_left_uv  = v2{aligned_quad.s0, aligned_quad.t1};
+        font.bitmap_data = (u8 *) malloc(font.width * font.height);
+        memcpy(font.bitmap_data, bitmap, font.width * font.height);
 
-        glyphs[i] = {
-            .position = {total_text_width, bottom_y},
-            .size = {width, height},
-            .uvs = {top_left_uv, top_right_uv, bottom_right_uv, bottom_left_uv}
-        };
+        *cache = {};
+        cache->padding = settings.padding;
+        cache->bitmap = font.bitmap_data;
+        cache->width = settings.width;
+        cache->page_height = header->page_height;
 
-        // if the character is not the last then add the advanced x to the total width
-        // because this includes the with of the character and also the kerning gap added
-        // for the next character, if it is the last one then just take the width and have
-        // no extra gap at the end - 20/01/25
-        if (i < text.len - 1) {
-            total_text_width += advanced_x;
-        } else {
-            total_text_width += width;
+        cache->pages.len = header->page_count;
+        memcpy(cache->pages.data, blob.ptr + header->pages_offset, sizeof(GlyphPage) * header->page_count);
+
+        CachedGlyph *glyphs = (CachedGlyph *) (blob.ptr + header->glyphs_offset);
+        for (i64 i = 0; i < header->glyph_count; i++) {
+            *find_cached_glyph(cache, glyphs[i].codepoint) = glyphs[i];
         }
+        cache->count = header->glyph_count;
     }
 
-    v2 pivot_point_translation = {};
-    f32 scale = font_size / text_height;
-
-    for (i64 i = 0; i < glyphs.len; i++) {
-        Glyph *glyph = &glyphs[i];
-
-        v2 scaled_position = glyph->position * scale;
-        v2 scaled_size = glyph->size * scale;
-        v2 translated_position = scaled_position + pivot_point_translation + position.XY;
-
-        // quad needs position to be centre of quad so just convert that here
-        v2 quad_centered_position = translated_position + (scaled_size * 0.5f);
+    renderer->font = font;
+    upload_font(renderer);
 
-        push_quad(renderer, v3{quad_centered_position.X, quad_centered_position.Y, 0}, scaled_size, 0, color, glyph->uvs, 3);
-   }
+    printf("%s font atlas %lldx%lld at %.0f px from \"%s\", %.1f KB, %.1f ms to map and upload\n",
+        settings.mode == FM_SDF ? "sdf" : "baked", (long long) settings.width, (long long) settings.height, settings.pixel_height,
+        path.c(), (f64) blob.len / 1024.0, (time_now() - start) * 1000.0);
 
-    mem_free(glyphs);
+    return true;
 }
 
-void new_frame(Renderer *renderer, Window *window, Camera camera) {
-    reset(&renderer->quads);
+// what load_font_blob reads, everything bake_font or bake_sdf_font made
+// plus the ttf they made it from. font_bake.cpp calls this
+bool write_font_blob(Renderer *renderer, FontSettings settings, const char *path) {
+    Font *font = &renderer->font;
+    GlyphCache *cache = &renderer->glyph_cache;
+
+    FontBlobHeader header = {
+        .magic = FONT_BLOB_MAGIC,
+        .version = FONT_BLOB_VERSION,
+        .metrics_size = sizeof(GlyphMetrics),
+        .cached_glyph_size = sizeof(CachedGlyph),
+        .page_size = sizeof(GlyphPage),
+        .settings = settings,
+    };
 
-    renderer->view_projection_matrix = HMM_MulM4(get_projection_matrix(camera, (f32) window->width / (f32) window->height), get_view_matrix(camera));
+    i64 glyph_size = 0;
+    if (settings.mode == FM_SDF) {
+        glyph_size = sizeof(CachedGlyph);
+        header.glyph_count = cache->count;
+        header.page_count = cache->pages.len;
+        header.page_height = cache->page_height;
+    } else {
+        glyph_size = sizeof(GlyphMetrics);
+        header.glyph_count = font->glyphs.size;
+    }
 
-    { // new frame for imgui
-        ImGui_ImplOpenGL3_NewFrame();
-        ImGui_ImplGlfw_NewFrame();
-        ImGui::NewFrame(); 
+    // every section starts on a cache line
+    i64 size = FONT_BLOB_ALIGN((i64) sizeof(FontBlobHeader));
+    header.glyphs_offset = size;
+    size = FONT_BLOB_ALIGN(size + header.glyph_count * glyph_size);
+    header.pages_offset = size;
+    size = FONT_BLOB_ALIGN(size + header.page_count * (i64) sizeof(GlyphPage));
+    header.bitmap_offset = size;
+    size = FONT_BLOB_ALIGN(size + font->width * font->height);
+    header.font_data_offset = size;
+    header.font_data_size = font->font_data.len;
+    size += font->font_data.len;
+
+    u8 *blob = (u8 *) calloc(size, 1);
+    memcpy(blob, &header, sizeof(header));
+
+    if (settings.mode == FM_SDF) {
+        // the used slots, load_font_blob puts them back in whichever slots
+        // they hash to
+        CachedGlyph *glyphs = (CachedGlyph *) (blob + header.glyphs_offset);
+        i64 count = 0;
+
+        for (i64 i = 0; i < GLYPH_CACHE_SLOTS; i++) {
+            if (cache->slots[i].used) {
+                glyphs[count] = cache->slots[i];
+                count += 1;
+            }
+        }
+        assert(count == header.glyph_count);
+
+        memcpy(blob + header.pages_offset, cache->pages.data, sizeof(GlyphPage) * header.page_count);
+    } else {
+        memcpy(blob + header.glyphs_offset, font->glyphs.data, sizeof(GlyphMetrics) * header.glyph_count);
     }
 
-    glClear(GL_COLOR_BUFFER_BIT);
-}
+    memcpy(blob + header.bitmap_offset, font->bitmap_data, font->width * font->height);
+    memcpy(blob + header.font_data_offset, font->font_data.ptr, font->font_data.len);
 
-void draw_frame(Renderer *renderer, Window *window) {
-    { // update the quad buffer and draw
-        glViewport(0, 0, window->width, window->height);
+    FILE *file = fopen(path, "wb");
+    if (file == nullptr) {
+        printf("failed to open \"%s\" to write the font blob\n", path);
+        free(blob);
+        return false;
+    }
 
-        glBindBuffer(GL_ARRAY_BUFFER, renderer->vertex_buffer_id);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(Quad) * renderer->quads.len, renderer->quads.data);
-        glBindVertexArray(renderer->vertex_array_id);
+    bool ok = fwrite(blob, size, 1, file) == 1;
+    fclose(file);
+    free(blob);
 
-        glUseProgram(renderer->shader_program_id);
+    if (!ok) {
+        printf("failed to write the font blob \"%s\"\n", path);
+    }
 
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, renderer->atlas_texture_id);
+    return ok;
+}
 
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, renderer->font_texture_id);
+// the whole atlas, the pages' dirty columns are in it so they're clean
+void upload_font(Renderer *renderer) {
+    Font *font = &renderer->font;
 
-        glDrawElements(GL_TRIANGLES, 6 * renderer->quads.len, GL_UNSIGNED_INT, 0);
-    }
+    renderer->font_texture_id = upload_font_to_gpu(renderer, font->width, font->height, font->bitmap_data);
+    assert(renderer->font_texture_id != 0);
 
-    { // imgui rendering
-        ImGui::Render();
-        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
-        GLFWwindow *current = glfwGetCurrentContext();
-        ImGui::UpdatePlatformWindows();
-        ImGui::RenderPlatformWindowsDefault();
-        glfwMakeContextCurrent(current);
+    GlyphCache *cache = &renderer->glyph_cache;
+    for (i64 i = 0; i < cache->pages.len; i++) {
+        cache->pages[i].dirty_x0 = 0;
+        cache->pages[i].dirty_x1 = 0;
     }
-
-    glfwSwapBuffers(window->glfw_window);
+}
+
+// stbtt_BakeFontBitmap of the ascii characters into renderer's font
+bool bake_font(Renderer *renderer, Slice<u8> font_data, FontSettings settings) {
+    Font font = Font{
+        .width = settings.width,
+        .height = settings.height,
+        .characters = {},
+        .bitmap_data = (u8 *) malloc(settings.width * settings.height),
+    };
+
+    font.font_data = font_data;
+
+    i64 bake_result = stbtt_BakeFontBitmap(font.font_data.ptr, 0, settings.pixel_height, font.bitmap_data, font.width, font.height, 32, font.characters.size, font.characters.data);
+    if (bake_result <= 0) {
+        return false;
+    }
+
+    // the bake used the same scale
+    stbtt_InitFont(&font.info, font.font_data.ptr, stbtt_GetFontOffsetForIndex(font.font_data.ptr, 0));
+    font.scale = stbtt_ScaleForPixelHeight(&font.info, settings.pixel_height);
+
+    // this is the the data for the aligned_quad we're given, with y+ going down
+    //	   x0, y0       x1, y0
+    //     s0, t0       s1, t0
+    //	    o tl        o tr
+
+
+    //     x0, y1      x1, y1
+    //     s0, t1      s1, t1
+    //	    o bl        o br
+    //
+    // x, and y and expected vertex positions
+    // s and t are texture uv position
+    for (i64 i = 0; i < font.glyphs.size; i++) {
+        f32 advanced_x = 0;
+        f32 advanced_y = 0;
+        stbtt_aligned_quad aligned_quad = {};
+
+        stbtt_GetBakedQuad(font.characters.data, font.width, font.height, i, &advanced_x, &advanced_y, &aligned_quad, false);
+
+        v2 top_left_uv     = v2{aligned_quad.s0, aligned_quad.t0};
+        v2 top_right_uv    = v2{aligned_quad.s1, aligned_quad.t0};
+        v2 bottom_right_uv = v2{aligned_quad.s1, aligned_quad.t1};
+        v2 bottom_left_uv  = v2{aligned_quad.s0, aligned_quad.t1};
+
+        font.glyphs[i] = {
+            .bottom_y = -aligned_quad.y1,
+            .size = {aligned_quad.x1 - aligned_quad.x0, aligned_quad.y1 - aligned_quad.y0},
+            .advance = advanced_x,
+            .uvs = {top_left_uv, top_right_uv, bottom_right_uv, bottom_left_uv},
+            .index = stbtt_FindGlyphIndex(&font.info, (i32) (32 + i)),
+        };
+    }
+
+    renderer->font = font;
+
+    return true;
+}
+
+// sets up the glyph cache with an empty atlas of as many pages as fit in
+// settings.height and adds the ascii glyphs so the first frames don't make
+// them one label at a time. the field is 0.5 on the edge of the glyph
+// and goes to 0 and 1 padding pixels out and in, the font program turns
+// that into about a pixel of antialiasing at any size
+bool bake_sdf_font(Renderer *renderer, Slice<u8> font_data, FontSettings settings) {
+    GlyphCache *cache = &renderer->glyph_cache;
+
+    i32 padding = settings.padding;
+
+    Font font = {};
+    font.width = settings.width;
+    font.height = settings.height;
+    font.padding = (f32) padding;
+    font.font_data = font_data;
+
+    if (!stbtt_InitFont(&font.info, font.font_data.ptr, stbtt_GetFontOffsetForIndex(font.font_data.ptr, 0))) {
+        return false;
+    }
+
+    font.scale = stbtt_ScaleForPixelHeight(&font.info, settings.pixel_height);
+
+    cache->padding = padding;
+    cache->count = 0;
+    cache->frame = 0;
+    cache->layouts_stale = false;
+
+    for (i64 i = 0; i < GLYPH_CACHE_SLOTS; i++) {
+        cache->slots[i] = {};
+    }
+
+    { // pages, a pixel between them so filtering never reads the next one
+        i32 x0, y0, x1, y1;
+        stbtt_GetFontBoundingBox(&font.info, &x0, &y0, &x1, &y1);
+
+        cache->page_height = (i64) ceilf((f32) (y1 - y0) * font.scale) + padding * 2 + 1;
+        cache->width = settings.width;
+
+        i64 page_count = min(settings.height / cache->page_height, (i64) MAX_GLYPH_PAGES);
+        if (page_count == 0) {
+            printf("sdf font atlas is shorter than one glyph\n");
+            return false;
+        }
+
+        cache->pages.len = page_count;
+        for (i64 i = 0; i < page_count; i++) {
+            cache->pages[i] = {
+                .y = i * cache->page_height,
+            };
+        }
+    }
+
+    font.bitmap_data = (u8 *) calloc(font.width * font.height, 1);
+
+    cache->bitmap = font.bitmap_data;
+    renderer->font = font;
+
+    for (u32 codepoint = 32; codepoint < 127; codepoint++) {
+        if (!cache_glyph(renderer, codepoint)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// metrics for the codepoint in whichever font mode, making it first if
+// it's an FM_SDF glyph that isn't cached. sets the bit for its page in
+// pages
+GlyphMetrics *get_glyph(Renderer *renderer, u32 codepoint, u64 *pages) {
+    Font *font = &renderer->font;
+
+    if (renderer->font_mode == FM_BAKED) {
+        if (codepoint < 32 || codepoint >= 32 + (u32) font->glyphs.size) {
+            codepoint = '?';
+        }
+
+        return &font->glyphs[codepoint - 32];
+    }
+
+    GlyphCache *cache = &renderer->glyph_cache;
+
+    CachedGlyph *glyph = find_cached_glyph(cache, codepoint);
+    if (!glyph->used) {
+        glyph = cache_glyph(renderer, codepoint);
+    }
+
+    // fails if the font can't be read or every page is in use this frame,
+    // the space has no page
+    if (!glyph) {
+        glyph = find_cached_glyph(cache, ' ');
+    }
+
+    if (glyph->page >= 0) {
+        cache->pages[glyph->page].last_used = cache->frame;
+        *pages |= 1ull << glyph->page;
+    }
+
+    return &glyph->metrics;
+}
+
+// where the codepoint's probe starts, top 10 bits of the hash
+u64 glyph_home_slot(u32 codepoint) {
+    u64 hash = (u64) codepoint * 0x9E3779B97F4A7C15ull;
+    return hash >> 54;
+}
+
+// the glyph's slot or the empty one it would go in
+CachedGlyph *find_cached_glyph(GlyphCache *cache, u32 codepoint) {
+    u64 start = glyph_home_slot(codepoint);
+
+    for (u64 i = 0; i < GLYPH_CACHE_SLOTS; i++) {
+        CachedGlyph *glyph = &cache->slots[(start + i) & (GLYPH_CACHE_SLOTS - 1)];
+
+        if (!glyph->used || glyph->codepoint == codepoint) {
+            return glyph;
+        }
+    }
+
+    // never gets here, cache_glyph keeps the table at most 3/4 full
+    assert(false);
+    return &cache->slots[0];
+}
+
+CachedGlyph *cache_glyph(Renderer *renderer, u32 codepoint) {
+    GlyphCache *cache = &renderer->glyph_cache;
+    Font *font = &renderer->font;
+    i32 padding = cache->padding;
+
+    i32 index = stbtt_FindGlyphIndex(&font->info, (i32) codepoint);
+    bool missing = index == 0 && codepoint != NOTDEF_CODEPOINT;
+
+    // room for the .notdef too if it has to be made first, so making it
+    // never empties a page and its copy always fits
+    i64 adding = missing && !find_cached_glyph(cache, NOTDEF_CODEPOINT)->used ? 2 : 1;
+
+    // a page holds at least a few glyphs so emptying one is always enough
+    while ((cache->count + adding) * 4 > GLYPH_CACHE_SLOTS * 3) {
+        i64 oldest = oldest_glyph_page(cache);
+        if (oldest < 0) {
+            renderer->packet->stats.glyphs_dropped += 1;
+            cache->layouts_stale = true; // lay it out again when there's room
+            return nullptr;
+        }
+
+        evict_glyph_page(cache, oldest);
+        renderer->packet->stats.glyph_pages_evicted += 1;
+    }
+
+    if (missing) {
+        CachedGlyph *notdef = find_cached_glyph(cache, NOTDEF_CODEPOINT);
+        if (!notdef->used) {
+            notdef = cache_glyph(renderer, NOTDEF_CODEPOINT);
+            if (!notdef) {
+                return nullptr;
+            }
+        }
+
+        CachedGlyph glyph = *notdef;
+        glyph.codepoint = codepoint;
+
+        CachedGlyph *slot = find_cached_glyph(cache, codepoint);
+        *slot = glyph;
+        cache->count += 1;
+
+        return slot;
+    }
+
+    const u8 on_edge = 128;
+    f32 pixel_dist_scale = (f32) on_edge / (f32) padding;
+
+    i32 width = 0;
+    i32 height = 0;
+    i32 x_offset = 0;
+    i32 y_offset = 0;
+
+    // null with a 0 size for glyphs with nothing to draw like space
+    u8 *bitmap = stbtt_GetGlyphSDF(&font->info, font->scale, index, padding, on_edge, pixel_dist_scale, &width, &height, &x_offset, &y_offset);
+    if (!bitmap) {
+        width = 0;
+        height = 0;
+    }
+
+    if (height > cache->page_height) {
+        printf("glyph %u is taller than a glyph page\n", codepoint);
+        stbtt_FreeSDF(bitmap, nullptr);
+        return nullptr;
+    }
+
+    i32 advance = 0;
+    i32 left_side_bearing = 0;
+    stbtt_GetGlyphHMetrics(&font->info, index, &advance, &left_side_bearing);
+
+    CachedGlyph glyph = {
+        .used = true,
+        .codepoint = codepoint,
+        .page = -1,
+    };
+
+    // metrics are the glyph without the padding like the baked ones,
+    // layout_text adds it back on
+    glyph.metrics.bottom_y = -(f32) (y_offset + height - padding);
+    glyph.metrics.advance = (f32) advance * font->scale;
+    glyph.metrics.index = index;
+
+    if (bitmap) {
+        glyph.metrics.size = {(f32) (width - padding * 2), (f32) (height - padding * 2)};
+
+        // a pixel between glyphs so filtering never reads a neighbour
+        i64 index = make_room_for_glyph(renderer, width + 1);
+        if (index < 0) {
+            renderer->packet->stats.glyphs_dropped += 1;
+            cache->layouts_stale = true;
+            stbtt_FreeSDF(bitmap, nullptr);
+            return nullptr;
+        }
+
+        GlyphPage *page = &cache->pages[index];
+
+        for (i64 row = 0; row < height; row++) {
+            memcpy(cache->bitmap + (page->y + row) * cache->width + page->x, bitmap + row * width, width);
+        }
+
+        f32 left_u   = (f32) page->x / (f32) font->width;
+        f32 right_u  = (f32) (page->x + width) / (f32) font->width;
+        f32 top_v    = (f32) page->y / (f32) font->height;
+        f32 bottom_v = (f32) (page->y + height) / (f32) font->height;
+
+        glyph.metrics.uvs[0] = {left_u, top_v};
+        glyph.metrics.uvs[1] = {right_u, top_v};
+        glyph.metrics.uvs[2] = {right_u, bottom_v};
+        glyph.metrics.uvs[3] = {left_u, bottom_v};
+
+        if (page->dirty_x0 >= page->dirty_x1) {
+            page->dirty_x0 = page->x;
+        }
+        page->x += width + 1;
+        page->dirty_x1 = page->x;
+        page->last_used = cache->frame;
+
+        glyph.page = (i32) index;
+
+        stbtt_FreeSDF(bitmap, nullptr);
+    }
+
+    CachedGlyph *slot = find_cached_glyph(cache, codepoint);
+    *slot = glyph;
+    cache->count += 1;
+
+    renderer->packet->stats.glyphs_rasterized += 1;
+
+    return slot;
+}
+
+// a page with width columns free, emptying the least recently used page
+// if none has. -1 when every page is in use this frame
+i64 make_room_for_glyph(Renderer *renderer, i64 width) {
+    GlyphCache *cache = &renderer->glyph_cache;
+
+    for (i64 i = 0; i < cache->pages.len; i++) {
+        if (cache->pages[i].x + width <= cache->width) {
+            return i;
+        }
+    }
+
+    i64 oldest = oldest_glyph_page(cache);
+    if (oldest >= 0) {
+        evict_glyph_page(cache, oldest);
+        renderer->packet->stats.glyph_pages_evicted += 1;
+    }
+
+    return oldest;
+}
+
+// the least recently used page with glyphs on it, -1 if they were all used
+// this frame. the packet's commands have the uvs of those so emptying one
+// would draw the new glyphs over text already queued
+i64 oldest_glyph_page(GlyphCache *cache) {
+    i64 oldest = -1;
+
+    for (i64 i = 0; i < cache->pages.len; i++) {
+        GlyphPage *page = &cache->pages[i];
+
+        if (page->x > 0 && page->last_used != cache->frame && (oldest < 0 || page->last_used < cache->pages[oldest].last_used)) {
+            oldest = i;
+        }
+    }
+
+    return oldest;
+}
+
+// forgets every glyph on the page
+void evict_glyph_page(GlyphCache *cache, i64 index) {
+    GlyphPage *page = &cache->pages[index];
+
+    page->x = 0;
+    page->dirty_x0 = 0;
+    page->dirty_x1 = 0;
+
+    for (u64 i = 0; i < GLYPH_CACHE_SLOTS; i++) {
+        // removing shifts the next glyph in the chain into this slot
+        while (cache->slots[i].used && cache->slots[i].page == index) {
+            remove_cached_glyph(cache, i);
+        }
+    }
+
+    cache->layouts_stale = true;
+}
+
+// empties the slot. the table is open addressed so the glyphs after it in
+// the same run are shifted back into the gap, leaving it empty would cut
+// their probe chains
+void remove_cached_glyph(GlyphCache *cache, u64 slot) {
+    u64 mask = GLYPH_CACHE_SLOTS - 1;
+    u64 gap = slot;
+
+    for (u64 next = (slot + 1) & mask; cache->slots[next].used; next = (next + 1) & mask) {
+        // distance from home to where it is, it can fill the gap if the gap
+        // is on its way there
+        u64 home = glyph_home_slot(cache->slots[next].codepoint);
+        if (((next - home) & mask) >= ((next - gap) & mask)) {
+            cache->slots[gap] = cache->slots[next];
+            gap = next;
+        }
+    }
+
+    cache->slots[gap] = {};
+    cache->count -= 1;
+}
+
+void touch_glyph_pages(GlyphCache *cache, u64 pages) {
+    for (i64 i = 0; i < cache->pages.len; i++) {
+        if (pages & (1ull << i)) {
+            cache->pages[i].last_used = cache->frame;
+        }
+    }
+}
+
+// game thread, copies the columns of each page that changed into the
+// packet so the render thread can upload them while new glyphs are added
+void copy_font_uploads(GlyphCache *cache, FramePacket *packet) {
+    reset(&packet->font_uploads);
+    packet->font_pixels.len = 0;
+
+    for (i64 i = 0; i < cache->pages.len; i++) {
+        GlyphPage *page = &cache->pages[i];
+        if (page->dirty_x0 >= page->dirty_x1) {
+            continue;
+        }
+
+        i64 width = page->dirty_x1 - page->dirty_x0;
+        i64 bytes = width * cache->page_height;
+
+        if (packet->font_pixels.len + bytes > packet->font_pixels_capacity) {
+            i64 capacity = max(packet->font_pixels_capacity * 2, packet->font_pixels.len + bytes);
+
+            packet->font_pixels.ptr = (u8 *) realloc(packet->font_pixels.ptr, capacity);
+            packet->font_pixels_capacity = capacity;
+        }
+
+        FontUpload upload = {
+            .x = (i32) page->dirty_x0,
+            .y = (i32) page->y,
+            .width = (i32) width,
+            .height = (i32) cache->page_height,
+            .offset = packet->font_pixels.len,
+        };
+
+        for (i64 row = 0; row < cache->page_height; row++) {
+            memcpy(packet->font_pixels.ptr + upload.offset + row * width, cache->bitmap + (page->y + row) * cache->width + page->dirty_x0, width);
+        }
+
+        append(&packet->font_uploads, upload);
+        packet->font_pixels.len += bytes;
+
+        page->dirty_x0 = 0;
+        page->dirty_x1 = 0;
+    }
+}
+
+void draw_rectangle(Renderer *renderer, v3 position, v2 size, v4 color) {
+    v2 uvs[4] = {
+        {0, 1},
+        {1, 1},
+        {1, 0},
+        {0, 0},
+    };
+
+    push_quad(renderer, position, size, 0, color, uvs, 0);
+}
+
+void draw_circle(Renderer *renderer, v3 position, f32 radius, v4 color) {
+    v2 size = {radius * 2, radius * 2};
+
+    v2 uvs[4] = {
+        {0, 1},
+        {1, 1},
+        {1, 0},
+        {0, 0},
+    };
+
+    push_quad(renderer, position, size, 0, color, uvs, 1);
+}
+
+void draw_texture(Renderer *renderer, TextureHandle handle, v3 position, v2 size, f32 rotation, v4 color) {
+    Texture *texture = &renderer->textures[handle];
+    push_quad(renderer, position, size, rotation, color, texture->uvs, 2);
+}
+
+void draw_text(Renderer *renderer, string text, v3 position, f32 font_size, v4 color) {
+    Label label = {
+        .text = text,
+        .position = {position.X, position.Y, 0},
+        .font_size = font_size,
+        .colour = color,
+    };
+
+    draw_labels(renderer, make_slice(&label, 1));
+}
+
+// lays out every label through the layout cache and writes its glyphs
+// straight into the command queue. everything push_quad works out per quad
+// is done once a label here, the colour, the sort key, the stats and the
+// cull test against the box around all its glyphs, only labels that cross
+// the edge of the camera get each glyph tested
+void draw_labels(Renderer *renderer, Slice<Label> labels) {
+    FramePacket *packet = renderer->packet;
+    CullBounds bounds = packet->cull_bounds;
+    f32 pixels_per_unit_squared = packet->pixels_per_unit * packet->pixels_per_unit;
+
+    for (i64 i = 0; i < labels.len; i++) {
+        Label *label = &labels[i];
+
+        TextLayout *layout = layout_text(renderer, label->text, label->font_size);
+        if (!layout) {
+            continue;
+        }
+
+        v2 min = layout->min + label->position.XY;
+        v2 max = layout->max + label->position.XY;
+
+        if (max.X < bounds.min.X || min.X > bounds.max.X || max.Y < bounds.min.Y || min.Y > bounds.max.Y) {
+            packet->stats.culled += layout->glyphs.len;
+            continue;
+        }
+
+        bool inside = min.X >= bounds.min.X && max.X <= bounds.max.X && min.Y >= bounds.min.Y && max.Y <= bounds.max.Y;
+
+        reserve_commands(renderer, layout->glyphs.len);
+
+        if (packet->last_material != MT_FONT) {
+            packet->last_material = MT_FONT;
+            packet->stats.push_runs += 1;
+        }
+
+        u32 colour = pack_colour(label->colour);
+        u64 key = make_sort_key(packet->layer, MT_FONT, label->position.Z, 0);
+
+        RenderCommand *commands = packet->commands.ptr;
+        u64 *sort_keys = packet->sort_keys.ptr;
+        i64 len = packet->commands.len;
+
+        for (i64 j = 0; j < layout->glyphs.len; j++) {
+            LaidOutGlyph *glyph = &layout->glyphs[j];
+
+            v3 position = {label->position.X + glyph->centre.X, label->position.Y + glyph->centre.Y, label->position.Z};
+
+            if (!inside && !quad_visible(bounds, position, glyph->size, 0)) {
+                packet->stats.culled += 1;
+                continue;
+            }
+
+            commands[len] = {
+                .position = position,
+                .size = glyph->size,
+                .rotation = 0,
+                .colour = colour,
+                .uvs = {glyph->uvs[0], glyph->uvs[1], glyph->uvs[2], glyph->uvs[3]},
+            };
+            sort_keys[len] = key | ((u64) (u32) len << SORT_KEY_SEQUENCE_SHIFT);
+            len += 1;
+        }
+
+        packet->commands.len = len;
+        packet->sort_keys.len = len;
+
+        packet->stats.pixels[MT_FONT] += (f64) (layout->area * pixels_per_unit_squared);
+    }
+}
+
+// width from the left of the first glyph to the right of the last, and
+// the font size tall, the same layout draw_text would use
+v2 measure_text(Renderer *renderer, string text, f32 font_size) {
+    TextLayout *layout = layout_text(renderer, text, font_size);
+    if (!layout) {
+        return {};
+    }
+
+    return layout->size;
+}
+
+void clear_text_layouts(TextLayoutCache *cache) {
+    for (i64 i = 0; i < TEXT_LAYOUT_SLOTS; i++) {
+        cache->slots[i] = {};
+    }
+
+    cache->count = 0;
+    arena_reset(&cache->arena);
+}
+
+// the cached layout or nullptr with empty_slot set to where it should go
+TextLayout *find_text_layout(TextLayoutCache *cache, u64 hash, string text, f32 font_size, TextLayout **empty_slot) {
+    for (u64 i = 0; i < TEXT_LAYOUT_SLOTS; i++) {
+        TextLayout *layout = &cache->slots[(hash + i) & (TEXT_LAYOUT_SLOTS - 1)];
+
+        if (layout->glyphs.len == 0) {
+            *empty_slot = layout;
+            return nullptr;
+        }
+
+        if (layout->hash == hash && layout->font_size == font_size && layout->text.len == text.len &&
+            memcmp(layout->text.ptr, text.ptr, text.len) == 0) {
+            return layout;
+        }
+    }
+
+    // never gets here, layout_text clears the table before it is full
+    *empty_slot = nullptr;
+    return nullptr;
+}
+
+// glyph quads for the text at the font size relative to where it is drawn,
+// laid out from the font's glyph metrics the first time it is seen
+// nullptr for empty text
+TextLayout *layout_text(Renderer *renderer, string text, f32 font_size) {
+    if (text.len == 0) {
+        return nullptr;
+    }
+
+    TextLayoutCache *cache = &renderer->text_layouts;
+    Font *font = &renderer->font;
+
+    if (renderer->glyph_cache.layouts_stale) {
+        clear_text_layouts(cache);
+        renderer->glyph_cache.layouts_stale = false;
+    }
+
+    u64 hash = hash_bytes(text);
+    TextLayout *slot = nullptr;
+
+    TextLayout *cached = find_text_layout(cache, hash, text, font_size, &slot);
+    if (cached) {
+        touch_glyph_pages(&renderer->glyph_cache, cached->pages);
+        renderer->packet->stats.text_cached += 1;
+        return cached;
+    }
+
+    renderer->packet->stats.text_laid_out += 1;
+
+    // keep the table at most 3/4 full so probes stay short
+    bool table_full = (cache->count + 1) * 4 > TEXT_LAYOUT_SLOTS * 3;
+    i64 bytes_needed = text.len * (i64) sizeof(LaidOutGlyph) + text.len + 2 * ARENA_ALIGNMENT;
+
+    if (table_full || cache->arena.used + bytes_needed > cache->arena.size) {
+        clear_text_layouts(cache);
+        find_text_layout(cache, hash, text, font_size, &slot);
+    }
+
+    Slice<LaidOutGlyph> glyphs = arena_alloc<LaidOutGlyph>(&cache->arena, text.len);
+    string text_copy = arena_alloc<u8>(&cache->arena, text.len);
+
+    // too long for even an empty arena. there are at most as many
+    // codepoints as bytes
+    if (!glyphs.ptr || !text_copy.ptr) {
+        return nullptr;
+    }
+
+    memcpy(text_copy.ptr, text.ptr, text.len);
+
+    f32 total_text_width = 0;
+    f32 text_height = 0;
+    u64 pages = 0;
+
+    i64 index = 0;
+    i64 glyph_count = 0;
+    i32 previous_index = 0;
+
+    while (index < text.len) {
+        u32 codepoint = decode_utf8(text, &index);
+        GlyphMetrics *metrics = get_glyph(renderer, codepoint, &pages);
+
+        // pairs like "AV" or "To" sit closer, from the font's kern table
+        // or gpos
+        if (glyph_count > 0) {
+            total_text_width += (f32) stbtt_GetGlyphKernAdvance(&font->info, previous_index, metrics->index) * font->scale;
+        }
+        previous_index = metrics->index;
+
+        if (metrics->size.Y > text_height) {
+            text_height = metrics->size.Y;
+        }
+
+        glyphs[glyph_count] = {
+            .centre = {total_text_width, metrics->bottom_y},
+            .size = metrics->size,
+            .uvs = {
+                pack_unorm16(metrics->uvs[0].X),
+                pack_unorm16(metrics->uvs[0].Y),
+                pack_unorm16(metrics->uvs[2].X),
+                pack_unorm16(metrics->uvs[2].Y),
+            },
+        };
+
+        // if the character is not the last then add the advanced x to the total width
+        // because this includes the with of the character and also the kerning gap added
+        // for the next character, if it is the last one then just take the width and have
+        // no extra gap at the end - 20/01/25
+        if (index < text.len) {
+            total_text_width += metrics->advance;
+        } else {
+            total_text_width += metrics->size.X;
+        }
+
+        glyph_count += 1;
+    }
+
+    glyphs.len = glyph_count;
+
+    f32 scale = text_height > 0 ? font_size / text_height : 0;
+
+    v2 min = {};
+    v2 max = {};
+    f32 area = 0;
+
+    for (i64 i = 0; i < glyphs.len; i++) {
+        LaidOutGlyph *glyph = &glyphs[i];
+
+        // quad needs position to be centre of quad so just convert that here
+        glyph->centre = (glyph->centre + (glyph->size * 0.5f)) * scale;
+
+        // the padding is on every side so the centre doesn't move
+        if (glyph->size.X > 0) {
+            glyph->size = glyph->size + v2{font->padding, font->padding} * 2.0f;
+        }
+        glyph->size = glyph->size * scale;
+
+        v2 glyph_min = glyph->centre - glyph->size * 0.5f;
+        v2 glyph_max = glyph->centre + glyph->size * 0.5f;
+
+        if (i == 0) {
+            min = glyph_min;
+            max = glyph_max;
+        }
+
+        min = {min(min.X, glyph_min.X), min(min.Y, glyph_min.Y)};
+        max = {max(max.X, glyph_max.X), max(max.Y, glyph_max.Y)};
+        area += glyph->size.X * glyph->size.Y;
+    }
+
+    *slot = {
+        .hash = hash,
+        .font_size = font_size,
+        .text = text_copy,
+        .glyphs = glyphs,
+        .pages = pages,
+        .size = {total_text_width * scale, font_size},
+        .min = min,
+        .max = max,
+        .area = area,
+    };
+    cache->count += 1;
+
+    return slot;
+}
+
+// makes the gl context current on a new thread that draws every packet
+// from here on, nothing on this thread can use gl after it
+bool start_render_thread(Renderer *renderer, Window *window) {
+    if (!renderer->thread) {
+        return true;
+    }
+
+    glfwMakeContextCurrent(nullptr);
+    renderer->thread->thread = std::thread(render_thread_main, renderer, window);
+
+    return true;
+}
+
+// draws whatever has been built and gives the gl context back
+void stop_render_thread(Renderer *renderer, Window *window) {
+    RenderThread *thread = renderer->thread;
+    if (!thread) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(thread->mutex);
+        thread->quit = true;
+    }
+
+    thread->built.notify_all();
+    thread->thread.join();
+
+    glfwMakeContextCurrent(window->glfw_window);
+}
+
+void render_thread_main(Renderer *renderer, Window *window) {
+    RenderThread *thread = renderer->thread;
+    glfwMakeContextCurrent(window->glfw_window);
+
+    while (true) {
+        FramePacket *packet = nullptr;
+
+        {
+            std::unique_lock<std::mutex> lock(thread->mutex);
+
+            f64 wait_start = time_now();
+            while (!thread->quit && thread->packets_drawn == thread->packets_built) {
+                thread->built.wait(lock);
+            }
+
+            if (thread->packets_drawn == thread->packets_built) {
+                break;
+            }
+
+            packet = &renderer->packets[thread->packets_drawn % FRAME_PACKETS];
+            packet->stats.render_wait_time = time_now() - wait_start;
+        }
+
+        draw_packet(renderer, window, packet);
+    }
+
+    glfwMakeContextCurrent(nullptr);
+}
+
+// until the render thread has drawn every packet built so far
+void wait_for_frames(Renderer *renderer) {
+    RenderThread *thread = renderer->thread;
+    if (!thread) {
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(thread->mutex);
+    while (thread->packets_drawn < thread->packets_built) {
+        thread->drawn.wait(lock);
+    }
+}
+
+RenderStats get_frame_stats(Renderer *renderer) {
+    if (!renderer->thread) {
+        return renderer->frame_stats;
+    }
+
+    std::lock_guard<std::mutex> lock(renderer->thread->mutex);
+    return renderer->frame_stats;
+}
+
+RenderStats get_total_stats(Renderer *renderer) {
+    if (!renderer->thread) {
+        return renderer->total_stats;
+    }
+
+    std::lock_guard<std::mutex> lock(renderer->thread->mutex);
+    return renderer->total_stats;
+}
+
+void add_stats(RenderStats *to, RenderStats *from) {
+    to->quads += from->quads;
+    to->culled += from->culled;
+    to->batches += from->batches;
+    to->draw_calls += from->draw_calls;
+    to->bytes_uploaded += from->bytes_uploaded;
+    to->layers += from->layers;
+    to->program_switches += from->program_switches;
+    to->sort_time += from->sort_time;
+    to->order_flushes += from->order_flushes;
+    to->stream_waits += from->stream_waits;
+    to->stream_wait_time += from->stream_wait_time;
+    to->render_time += from->render_time;
+    to->render_wait_time += from->render_wait_time;
+    to->game_wait_time += from->game_wait_time;
+    to->push_runs += from->push_runs;
+    to->text_cached += from->text_cached;
+    to->text_laid_out += from->text_laid_out;
+    to->glyphs_rasterized += from->glyphs_rasterized;
+    to->glyph_pages_evicted += from->glyph_pages_evicted;
+    to->glyphs_dropped += from->glyphs_dropped;
+    to->font_bytes_uploaded += from->font_bytes_uploaded;
+
+    for (i64 i = 0; i < MT_COUNT__; i++) {
+        to->pixels[i] += from->pixels[i];
+    }
+}
+
+// game thread, waits for the next packet to be free if the render thread
+// is behind and starts building the frame in it
+void new_frame(Renderer *renderer, Window *window, Camera camera) {
+    f64 wait_time = 0;
+
+    if (renderer->thread) {
+        RenderThread *thread = renderer->thread;
+        std::unique_lock<std::mutex> lock(thread->mutex);
+
+        f64 wait_start = time_now();
+        while (thread->packets_built - thread->packets_drawn >= FRAME_PACKETS) {
+            thread->drawn.wait(lock);
+        }
+        wait_time = time_now() - wait_start;
+
+        renderer->packet = &renderer->packets[thread->packets_built % FRAME_PACKETS];
+    }
+
+    FramePacket *packet = renderer->packet;
+
+    packet->commands.len = 0;
+    packet->sort_keys.len = 0;
+    packet->layer = 0;
+    packet->last_material = -1;
+    packet->stats = {};
+    packet->stats.game_wait_time = wait_time;
+
+    renderer->glyph_cache.frame += 1;
+
+    packet->width = window->width;
+    packet->height = window->height;
+    packet->view_projection_matrix = HMM_MulM4(get_projection_matrix(camera, (f32) window->width / (f32) window->height), get_view_matrix(camera));
+    packet->pixels_per_unit = (f32) window->height / (camera.orthographic_size * 2);
+
+    { // what get_projection_matrix shows around the camera
+        f32 half_height = camera.orthographic_size;
+        f32 half_width = camera.orthographic_size * (f32) window->width / (f32) window->height;
+
+        packet->cull_bounds = {
+            .min = {camera.position.X - half_width, camera.position.Y - half_height},
+            .max = {camera.position.X + half_width, camera.position.Y + half_height},
+        };
+    }
+
+    { // new frame for imgui, the gl half is in draw_packet
+        ImGui_ImplGlfw_NewFrame();
+        ImGui::NewFrame(); 
+    }
+}
+
+// game thread, hands the packet to the render thread or draws it here
+// without one
+void draw_frame(Renderer *renderer, Window *window) {
+    ImGui::Render();
+
+    copy_font_uploads(&renderer->glyph_cache, renderer->packet);
+
+    RenderThread *thread = renderer->thread;
+    if (!thread) {
+        draw_packet(renderer, window, renderer->packet);
+        return;
+    }
+
+    copy_imgui_draw_data(ImGui::GetDrawData(), &renderer->packet->imgui_draw_data);
+
+    {
+        std::lock_guard<std::mutex> lock(thread->mutex);
+        thread->packets_built += 1;
+    }
+
+    thread->built.notify_one();
+}
+
+// whichever thread has the gl context
+void draw_packet(Renderer *renderer, Window *window, FramePacket *packet) {
+    f64 start = time_now();
+
+    for (i64 i = 0; i < MT_COUNT__; i++) {
+        renderer->batches[i] = begin_stream_region(&renderer->stream, i);
+        renderer->batch_lens[i] = 0;
+        renderer->batch_tiles[i] = 0;
+    }
+
+    i64 stream_waits = renderer->stream.waits;
+    f64 stream_wait_time = renderer->stream.wait_time;
+
+    renderer->quad_batch.len = 0;
+    renderer->stats = {};
+    renderer->current_program = 0;
+    renderer->view_projection_matrix = packet->view_projection_matrix;
+
+    glViewport(0, 0, packet->width, packet->height);
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, renderer->atlas_texture_id);
+
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, renderer->font_texture_id);
+
+    if (packet->font_uploads.len > 0) { // new glyphs, rows are as wide as the upload
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+        for (i64 i = 0; i < packet->font_uploads.len; i++) {
+            FontUpload *upload = &packet->font_uploads[i];
+
+            glTexSubImage2D(GL_TEXTURE_2D, 0, upload->x, upload->y, upload->width, upload->height, GL_RED, GL_UNSIGNED_BYTE, packet->font_pixels.ptr + upload->offset);
+            renderer->stats.font_bytes_uploaded += (i64) upload->width * upload->height;
+        }
+
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    }
+
+    glBindVertexArray(renderer->vertex_array_id);
+
+    if (renderer->path == RP_INSTANCED) {
+        for (i64 i = 0; i < MT_COUNT__; i++) {
+            glProgramUniformMatrix4fv(renderer->programs[i], renderer->view_projection_locations[i], 1, GL_FALSE, &renderer->view_projection_matrix.Elements[0][0]);
+        }
+    }
+
+    ImGui_ImplOpenGL3_NewFrame();
+
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    flush_commands(renderer, packet);
+
+    { // imgui rendering
+        if (renderer->thread) {
+            ImGui_ImplOpenGL3_RenderDrawData(&packet->imgui_draw_data);
+        } else {
+            ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+            GLFWwindow *current = glfwGetCurrentContext();
+            ImGui::UpdatePlatformWindows();
+            ImGui::RenderPlatformWindowsDefault();
+            glfwMakeContextCurrent(current);
+        }
+    }
+
+    glfwSwapBuffers(window->glfw_window);
+
+    renderer->stats.stream_waits = renderer->stream.waits - stream_waits;
+    renderer->stats.stream_wait_time = renderer->stream.wait_time - stream_wait_time;
+    renderer->stats.render_time = time_now() - start;
+
+    add_stats(&packet->stats, &renderer->stats);
+
+    RenderThread *thread = renderer->thread;
+    if (!thread) {
+        renderer->frame_stats = packet->stats;
+        add_stats(&renderer->total_stats, &packet->stats);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(thread->mutex);
+
+        renderer->frame_stats = packet->stats;
+        add_stats(&renderer->total_stats, &packet->stats);
+        thread->packets_drawn += 1;
+    }
+
+    thread->drawn.notify_one();
+}
+
+// frees the last clones in to
+void copy_imgui_draw_data(ImDrawData *from, ImDrawData *to) {
+    for (i32 i = 0; i < to->CmdLists.Size; i++) {
+        IM_DELETE(to->CmdLists[i]);
+    }
+
+    *to = *from;
+
+    for (i32 i = 0; i < to->CmdLists.Size; i++) {
+        to->CmdLists[i] = from->CmdLists[i]->CloneOutput();
+    }
+}
+
+// everything pushed after this is drawn over everything pushed before
+void next_layer(Renderer *renderer) {
+    FramePacket *packet = renderer->packet;
+    assert(packet->layer < MAX_RENDER_LAYERS - 1);
+
+    packet->layer += 1;
+    packet->stats.layers += 1;
+}
+
+void flush_quads(Renderer *renderer) {
+    for (i64 i = 0; i < MT_COUNT__; i++) {
+        flush_material(renderer, (Material) i);
+    }
+}
+
+// draws the material's batch and starts its next one in the following
+// region of its ring. the quads are already in the mapped buffer, the draw
+// just starts at the first vertex or instance of the batch's region
+void flush_material(Renderer *renderer, Material material) {
+    i64 len = renderer->batch_lens[material];
+    if (len == 0) {
+        return;
+    }
+
+    // the pending positions can be for any material, this one just needs
+    // its own done
+    if (renderer->quad_batch.len > 0 && renderer->format == VF_FLOATS) {
+        transform_quads(renderer->view_projection_matrix, &renderer->quad_batch);
+    }
+
+    if (renderer->quad_batch.len > 0 && renderer->format == VF_PACKED) {
+        transform_packed_quads(renderer->view_projection_matrix, &renderer->quad_batch);
+    }
+
+    u32 program = renderer->programs[material];
+    if (program != renderer->current_program) {
+        glUseProgram(program);
+
+        renderer->current_program = program;
+        renderer->stats.program_switches += 1;
+    }
+
+    i64 region = stream_region_index(&renderer->stream, material);
+
+    if (renderer->path == RP_VERTICES) {
+        glDrawElementsBaseVertex(GL_TRIANGLES, 6 * len, GL_UNSIGNED_SHORT, 0, region * BATCH_QUADS * 4);
+    }
+
+    if (renderer->path == RP_INSTANCED) { // 6 vertices for each instance
+        glDrawArraysInstancedBaseInstance(GL_TRIANGLES, 0, 6, len, region * BATCH_QUADS);
+    }
+
+    end_stream_region(&renderer->stream, material);
+
+    renderer->stats.quads += len;
+    renderer->stats.batches += 1;
+    renderer->stats.draw_calls += 1;
+    renderer->stats.bytes_uploaded += renderer->quad_bytes * len;
+
+    renderer->batches[material] = begin_stream_region(&renderer->stream, material);
+    renderer->batch_lens[material] = 0;
+    renderer->batch_tiles[material] = 0;
 }
 
 void push_quad(Renderer *renderer, v3 position, v2 size, f32 rotation, v4 color, v2 uvs[4], i32 draw_type) {
-    const v4 top_left      = {-0.5,   0.5, 0, 1};
-    const v4 top_right     = { 0.5,   0.5, 0, 1};
-    const v4 bottom_right  = { 0.5,  -0.5, 0, 1};
-    const v4 bottom_left   = {-0.5,  -0.5, 0, 1};
-
-    m4 model_matrix = HMM_M4D(1.0f);
-    model_matrix = HMM_MulM4(model_matrix, HMM_Translate(position));
-    model_matrix = HMM_MulM4(model_matrix, HMM_Scale({size.X, size.Y, 1}));
-    model_matrix = HMM_MulM4(model_matrix, HMM_Rotate_LH(rotation * HMM_DegToRad, {0, 0, 1}));
-                
-    m4 mvp_matrix = HMM_MulM4(renderer->view_projection_matrix, model_matrix);
-
-    Quad *quad = push(&renderer->quads);
-               
-    quad->vertices[0].position = HMM_MulM4V4(mvp_matrix, top_left).XYZ;
-    quad->vertices[1].position = HMM_MulM4V4(mvp_matrix, top_right).XYZ;
-    quad->vertices[2].position = HMM_MulM4V4(mvp_matrix, bottom_right).XYZ;
-    quad->vertices[3].position = HMM_MulM4V4(mvp_matrix, bottom_left).XYZ;
-                
+    Material material = (Material) draw_type;
+    FramePacket *packet = renderer->packet;
+
+    if (!quad_visible(packet->cull_bounds, position, size, rotation)) {
+        packet->stats.culled += 1;
+        return;
+    }
+
+    { // stats
+        if (draw_type != packet->last_material) {
+            packet->last_material = draw_type;
+            packet->stats.push_runs += 1;
+        }
+
+        packet->stats.pixels[material] += (f64) (size.X * size.Y * packet->pixels_per_unit * packet->pixels_per_unit);
+    }
+
+    // uvs are in top left, top right, bottom right, bottom left order and
+    // always axis aligned so only the top left and bottom right are kept
+    RenderCommand command = {
+        .position = position,
+        .size = size,
+        .rotation = rotation,
+        .colour = pack_colour(color),
+        .uvs = {
+            pack_unorm16(uvs[0].X),
+            pack_unorm16(uvs[0].Y),
+            pack_unorm16(uvs[2].X),
+            pack_unorm16(uvs[2].Y),
+        },
+    };
+
+    push_command(renderer, command, material);
+}
+
+void push_command(Renderer *renderer, RenderCommand command, Material material) {
+    FramePacket *packet = renderer->packet;
+
+    reserve_commands(renderer, 1);
+
+    u32 sequence = (u32) packet->commands.len;
+
+    packet->commands[packet->commands.len] = command;
+    packet->commands.len += 1;
+
+    packet->sort_keys[packet->sort_keys.len] = make_sort_key(packet->layer, material, command.position.Z, sequence);
+    packet->sort_keys.len += 1;
+}
+
+// grows the queue so count more commands fit
+void reserve_commands(Renderer *renderer, i64 count) {
+    FramePacket *packet = renderer->packet;
+
+    if (packet->commands.len + count > packet->command_capacity) {
+        i64 capacity = max(packet->command_capacity * 2, packet->commands.len + count);
+
+        Slice<RenderCommand> commands = mem_alloc<RenderCommand>(capacity);
+        Slice<u64> sort_keys = mem_alloc<u64>(capacity);
+
+        memcpy(commands.ptr, packet->commands.ptr, packet->commands.len * sizeof(RenderCommand));
+        memcpy(sort_keys.ptr, packet->sort_keys.ptr, packet->sort_keys.len * sizeof(u64));
+        commands.len = packet->commands.len;
+        sort_keys.len = packet->sort_keys.len;
+
+        mem_free(packet->commands);
+        mem_free(packet->sort_keys);
+        mem_free(packet->sort_scratch);
+
+        packet->commands = commands;
+        packet->sort_keys = sort_keys;
+        packet->sort_scratch = mem_alloc<u64>(capacity);
+        packet->command_capacity = capacity;
+    }
+}
+
+// sorts the queue and writes every command into its material's batch in
+// key order. flush_quads draws the batches in material order, which is
+// only right while nothing in a batch overlaps something earlier in key
+// order in a later material's batch. each batch keeps which tiles of the
+// screen its quads touch, and a quad that lands on a later material's
+// tiles draws everything waiting first
+void flush_commands(Renderer *renderer, FramePacket *packet) {
+    f64 sort_start = time_now();
+
+    // the keys went in in sequence order so the low 4 bytes are sorted already
+    u64 *keys = radix_sort_keys(packet->sort_keys.ptr, packet->sort_scratch.ptr, packet->sort_keys.len, 4);
+
+    renderer->stats.sort_time += time_now() - sort_start;
+
+    u64 last_layer = 0;
+
+    for (i64 i = 0; i < packet->sort_keys.len; i++) {
+        u64 key = keys[i];
+        u64 layer = key >> SORT_KEY_LAYER_SHIFT;
+
+        if (layer != last_layer) {
+            flush_quads(renderer);
+            last_layer = layer;
+        }
+
+        Material material = (Material) (key & SORT_KEY_MATERIAL_MASK);
+        RenderCommand *command = &packet->commands[(i64) (u32) (key >> SORT_KEY_SEQUENCE_SHIFT)];
+
+        u64 tiles = quad_tiles(packet->cull_bounds, command->position, command->size);
+
+        for (i64 later = material + 1; later < MT_COUNT__; later++) {
+            if (renderer->batch_tiles[later] & tiles) {
+                flush_quads(renderer);
+                renderer->stats.order_flushes += 1;
+                break;
+            }
+        }
+
+        // drawing just this batch would put it before earlier quads in the
+        // others
+        if (renderer->batch_lens[material] == BATCH_QUADS) {
+            flush_quads(renderer);
+        }
+
+        renderer->batch_tiles[material] |= tiles;
+
+        if (renderer->path == RP_INSTANCED) {
+            write_instance(renderer, command, material);
+        } else {
+            write_quad(renderer, command, material);
+        }
+    }
+
+    flush_quads(renderer);
+}
+
+// the 4 corners of a command for the RP_VERTICES path, the room in the
+// batch has already been made
+void write_quad(Renderer *renderer, RenderCommand *command, Material material) {
+    if (renderer->format == VF_PACKED) {
+        PackedQuad *packed = (PackedQuad *) renderer->batches[material] + renderer->batch_lens[material];
+        renderer->batch_lens[material] += 1;
+
+        if (batch_packed_quad(&renderer->quad_batch, command->position, command->size, command->rotation, packed)) {
+            transform_packed_quads(renderer->view_projection_matrix, &renderer->quad_batch);
+        }
+
+        // top left, top right, bottom right, bottom left
+        u16 us[4] = {command->uvs[0], command->uvs[2], command->uvs[2], command->uvs[0]};
+        u16 vs[4] = {command->uvs[1], command->uvs[1], command->uvs[3], command->uvs[3]};
+
+        for (i64 i = 0; i < 4; i++) {
+            packed->vertices[i].colour = command->colour;
+            packed->vertices[i].uv[0] = us[i];
+            packed->vertices[i].uv[1] = vs[i];
+            packed->vertices[i].draw_type = (u8) material;
+        }
+
+        return;
+    }
+
+    Quad *quad = (Quad *) renderer->batches[material] + renderer->batch_lens[material];
+    renderer->batch_lens[material] += 1;
+
+    // positions are filled in a batch at a time, see quad.cpp
+    if (batch_quad(&renderer->quad_batch, command->position, command->size, command->rotation, quad)) {
+        transform_quads(renderer->view_projection_matrix, &renderer->quad_batch);
+    }
+
+    u32 colour = command->colour;
+    v4 color = {
+        (f32) (colour & 0xff) / 255.0f,
+        (f32) ((colour >> 8) & 0xff) / 255.0f,
+        (f32) ((colour >> 16) & 0xff) / 255.0f,
+        (f32) (colour >> 24) / 255.0f,
+    };
+
+    f32 left = (f32) command->uvs[0] / 65535.0f;
+    f32 top = (f32) command->uvs[1] / 65535.0f;
+    f32 right = (f32) command->uvs[2] / 65535.0f;
+    f32 bottom = (f32) command->uvs[3] / 65535.0f;
+
     quad->vertices[0].colour = color;
     quad->vertices[1].colour = color;
     quad->vertices[2].colour = color;
     quad->vertices[3].colour = color;
 
-    quad->vertices[0].uv = uvs[0];
-    quad->vertices[1].uv = uvs[1];
-    quad->vertices[2].uv = uvs[2];
-    quad->vertices[3].uv = uvs[3];
+    quad->vertices[0].uv = {left, top};
+    quad->vertices[1].uv = {right, top};
+    quad->vertices[2].uv = {right, bottom};
+    quad->vertices[3].uv = {left, bottom};
+
+    quad->vertices[0].draw_type = material;
+    quad->vertices[1].draw_type = material;
+    quad->vertices[2].draw_type = material;
+    quad->vertices[3].draw_type = material;
+}
+
+// a command is most of an Instance already
+void write_instance(Renderer *renderer, RenderCommand *command, Material material) {
+    Instance *instance = (Instance *) renderer->batches[material] + renderer->batch_lens[material];
+    renderer->batch_lens[material] += 1;
+
+    instance->position  = command->position.XY;
+    instance->size      = command->size;
+    instance->rotation  = command->rotation;
+    instance->colour    = command->colour;
+    instance->draw_type = material;
+
+    instance->uvs[0] = command->uvs[0];
+    instance->uvs[1] = command->uvs[1];
+    instance->uvs[2] = command->uvs[2];
+    instance->uvs[3] = command->uvs[3];
+}
+
+u64 make_sort_key(u8 layer, Material material, f32 depth, u32 sequence) {
+    // flipping the sign bit of positive floats and every bit of negative
+    // ones makes the bits sort the same way the floats do
+    u32 bits = 0;
+    memcpy(&bits, &depth, sizeof(bits));
+    bits ^= (bits & 0x80000000) ? 0xffffffff : 0x80000000;
+
+    // bigger z is further away, those go first. the top 20 bits keep the
+    // sign, exponent and 11 bits of mantissa, anything closer than that
+    // falls back to push order
+    u64 far_first = (~bits) >> 12;
+
+    return ((u64) layer << SORT_KEY_LAYER_SHIFT) |
+           (far_first << SORT_KEY_DEPTH_SHIFT) |
+           ((u64) sequence << SORT_KEY_SEQUENCE_SHIFT) |
+           (u64) material;
+}
+
+// lsd radix sort a byte at a time from first_byte up, anything below it
+// has to be in order already. a byte that is the same in every key is
+// skipped, in the game that is most of them. returns keys or scratch,
+// whichever ended up with the sorted keys
+u64 *radix_sort_keys(u64 *keys, u64 *scratch, i64 count, i64 first_byte) {
+    i64 counts[8][256] = {};
+
+    for (i64 i = 0; i < count; i++) {
+        u64 key = keys[i];
+
+        for (i64 byte = first_byte; byte < 8; byte++) {
+            counts[byte][(key >> (byte * 8)) & 0xff] += 1;
+        }
+    }
+
+    for (i64 byte = first_byte; byte < 8; byte++) {
+        i64 *histogram = counts[byte];
+
+        if (count == 0 || histogram[(keys[0] >> (byte * 8)) & 0xff] == count) {
+            continue;
+        }
+
+        i64 offsets[256];
+        i64 offset = 0;
+        for (i64 i = 0; i < 256; i++) {
+            offsets[i] = offset;
+            offset += histogram[i];
+        }
+
+        for (i64 i = 0; i < count; i++) {
+            u64 key = keys[i];
+            scratch[offsets[(key >> (byte * 8)) & 0xff]++] = key;
+        }
+
+        u64 *sorted = scratch;
+        scratch = keys;
+        keys = sorted;
+    }
 
-    quad->vertices[0].draw_type = draw_type;
-    quad->vertices[1].draw_type = draw_type;
-    quad->vertices[2].draw_type = draw_type;
-    quad->vertices[3].draw_type = draw_type;
+    return keys;
 }
 
 m4 get_view_matrix(Camera camera) {
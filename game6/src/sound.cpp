@@ -1,7 +1,7 @@
 #ifndef SOUND_CPP
 #define SOUND_CPP
 
-#include "libs/libs.h"
+#include "backend.h"
 #include "game.h"
 
 enum SoundHandle {
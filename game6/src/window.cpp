@@ -1,7 +1,7 @@
 #ifndef WINDOW_CPP
 #define WINDOW_CPP
 
-#include "libs/libs.h"
+#include "backend.h"
 #include "game.h"
 
 struct Window {
@@ -18,6 +18,10 @@ enum class InputState {
 };
 
 Array<InputState, 348> KEYS = {};
+// let go before anything saw it go down. the key stays down until
+// consume_key_presses or consume_frame_key sees it, then goes up, so a
+// tap shorter than a tick still counts
+Array<bool, 348> KEYS_RELEASED = {};
 
 bool init_window(i32 width, i32 height, string title);
 void glfw_key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
@@ -63,11 +67,16 @@ void glfw_error_callback(int error_code, const char* description) {
 void glfw_key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
     switch (action) {
          case GLFW_RELEASE:	{
-            KEYS[key] = InputState::up;
+            if (KEYS[key] == InputState::down) {
+                KEYS_RELEASED[key] = true;
+            } else {
+                KEYS[key] = InputState::up;
+            }
             break;
         }
         case GLFW_PRESS: {
             KEYS[key] = InputState::down;
+            KEYS_RELEASED[key] = false;
             break;
         }
         case GLFW_REPEAT: break;